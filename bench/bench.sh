@@ -0,0 +1,26 @@
+#!/bin/sh
+# headless benchmark: starts Xvfb with two xinerama screens, a -DBENCH build
+# of iwm and the client generator, arguments are passed on to bench/xgen
+
+cd "$(dirname "$0")/.."
+
+DPY=${BENCH_DISPLAY:-:97}
+SCREEN=${BENCH_SCREEN:-1280x800x24}
+
+command -v Xvfb >/dev/null || { echo "bench: Xvfb not found" >&2; exit 1; }
+
+Xvfb "$DPY" +xinerama -screen 0 "$SCREEN" -screen 1 "$SCREEN" -nolisten tcp >/dev/null 2>&1 &
+xvfb=$!
+trap 'kill $wm $xvfb 2>/dev/null' EXIT INT TERM
+
+# wait for the server socket
+for i in $(seq 50); do
+	[ -e "/tmp/.X11-unix/X${DPY#:}" ] && break
+	sleep 0.1
+done
+
+DISPLAY=$DPY ./bench/iwm-bench >/dev/null 2>&1 &
+wm=$!
+
+# xgen keeps asking until the wm answers
+DISPLAY=$DPY ./bench/xgen "$@"
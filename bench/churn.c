@@ -0,0 +1,246 @@
+// client churn microbenchmark: keeps a working set of clients on a monitor
+// and repeatedly manages a new window and unmanages a random one, comparing
+// malloc with a tail walk against the pool with the O(1) pushclient
+// the second half runs the whole state machine of core.c against the mock
+// backend, with focus changes and clients moving between monitors and
+// workspaces mixed in, and checks its invariants along the way, then times
+// switching between workspaces
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../iwm.h"
+#include "../list.h"
+#include "../pool.h"
+#include "../wintab.h"
+#include "../core.h"
+#include "mock.h"
+
+#define OPS 200000
+#define POLICY_OPS 100000
+#define SWITCH_OPS 100000
+// invariants are checked every CHECK_EVERY ops
+#define CHECK_EVERY 4096
+
+#define LENGTH(X) (sizeof(X) / sizeof((X)[0]))
+
+static unsigned int seed = 1;
+
+static unsigned int xorshift() {
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// what pushclient used to do, walk to the end of the list
+static void pushwalk(Client *c, Workspace *w) {
+	c->mon = w->mon;
+	c->ws = w;
+	c->next = NULL;
+	if (w->clients == NULL) {
+		c->prev = NULL;
+		w->clients = w->tail = c;
+		return;
+	}
+	Client *cc = w->clients;
+	while (cc->next != NULL) {
+		cc = cc->next;
+	}
+	cc->next = c;
+	c->prev = cc;
+	w->tail = c;
+}
+
+static double churn(int live, Bool pooled) {
+	Workspace w;
+	memset(&w, 0, sizeof(w));
+	Pool pool;
+	poolinit(&pool, sizeof(Client), 64);
+
+	Client **set = malloc(live * sizeof(Client *));
+	seed = 1;
+
+	for (int i = 0; i < live; i++) {
+		set[i] = pooled ? poolalloc(&pool) : malloc(sizeof(Client));
+		pooled ? pushclient(set[i], &w) : pushwalk(set[i], &w);
+	}
+
+	double start = now();
+	for (int i = 0; i < OPS; i++) {
+		// a notification shows up...
+		Client *c = pooled ? poolalloc(&pool) : malloc(sizeof(Client));
+		pooled ? pushclient(c, &w) : pushwalk(c, &w);
+
+		// ...and some window goes away
+		int victim = xorshift() % live;
+		Client *old = set[victim];
+		set[victim] = c;
+		ripclient(old, &w);
+		if (pooled) {
+			poolfree(&pool, old);
+		} else {
+			free(old);
+		}
+	}
+	double elapsed = now() - start;
+
+	if (!pooled) {
+		for (int i = 0; i < live; i++) {
+			free(set[i]);
+		}
+	}
+	free(set);
+
+	return elapsed * 1e9 / OPS;
+}
+
+const Bool hideclients = True;
+
+static Window lastwnd = 0;
+
+// what manage does once the X side is done
+static Window addwindow() {
+	Client *c = addclient(++lastwnd, fmon);
+	int x, y, w, h;
+	monarea(fmon, &x, &y, &w, &h);
+	configclient(c, x, y, w, h);
+	return c->wnd;
+}
+
+static void check(Bool settled, int op) {
+	const char *err = mockcheck(settled);
+	if (err == NULL) return;
+
+	fprintf(stderr, "churn: op %d: %s, last requests:\n", op, err);
+	MockReq reqs[16];
+	int n = mocklog(reqs, LENGTH(reqs));
+	for (int i = 0; i < n; i++) {
+		fprintf(stderr, "\t%s %lu\n", mockopnames[reqs[i].op], reqs[i].wnd);
+	}
+	exit(EXIT_FAILURE);
+}
+
+// one event worth of policy followed by the refresh that applies it
+static double policy(int live, unsigned long *requests) {
+	mockinit(2, 1920, 1080, 64);
+	Window *set = malloc(live * sizeof(Window));
+	seed = 1;
+
+	for (int i = 0; i < live; i++) {
+		set[i] = addwindow();
+	}
+	applydirty();
+	check(True, 0);
+	mockreset();
+
+	double start = now();
+	for (int i = 0; i < POLICY_OPS; i++) {
+		int victim = xorshift() % live;
+		int ws = xorshift() % NWORKSPACES;
+		switch (xorshift() % 10) {
+		case 0:
+			sendmon(fmon->sel->focused, fmon->next != NULL ? fmon->next : mons);
+			break;
+		case 8:
+			selectws(fmon, &fmon->ws[ws]);
+			break;
+		case 9:
+			sendws(fmon->sel->focused, &fmon->ws[ws]);
+			break;
+		case 1:
+			focusmon(fmon->next != NULL ? fmon->next : mons);
+			break;
+		case 2:
+		case 3:
+			focus(wtlookup(set[victim])->client);
+			break;
+		default:
+			delclient(wtlookup(set[victim])->client);
+			set[victim] = addwindow();
+			break;
+		}
+		if (i % CHECK_EVERY == 0) {
+			check(False, i);
+		}
+		applydirty();
+		if (i % CHECK_EVERY == 0) {
+			check(True, i);
+		}
+	}
+	double elapsed = now() - start;
+	check(True, POLICY_OPS);
+
+	*requests = 0;
+	for (int op = 0; op < MockOps; op++) {
+		*requests += mockcount[op];
+	}
+	for (int i = 0; i < live; i++) {
+		delclient(wtlookup(set[i])->client);
+	}
+	free(set);
+
+	return elapsed * 1e9 / POLICY_OPS;
+}
+
+// clients spread over all workspaces of one monitor, cycling through them
+static double switching(int live, unsigned long *requests) {
+	mockinit(1, 1920, 1080, 64);
+	Window *set = malloc(live * sizeof(Window));
+
+	for (int i = 0; i < live; i++) {
+		set[i] = addwindow();
+		sendws(fmon->sel->focused, &fmon->ws[i % NWORKSPACES]);
+	}
+	applydirty();
+	check(True, 0);
+	mockreset();
+
+	double start = now();
+	for (int i = 0; i < SWITCH_OPS; i++) {
+		selectws(fmon, &fmon->ws[i % NWORKSPACES]);
+		applydirty();
+	}
+	double elapsed = now() - start;
+	check(True, SWITCH_OPS);
+
+	*requests = 0;
+	for (int op = 0; op < MockOps; op++) {
+		*requests += mockcount[op];
+	}
+	for (int i = 0; i < live; i++) {
+		delclient(wtlookup(set[i])->client);
+	}
+	free(set);
+
+	return elapsed * 1e9 / SWITCH_OPS;
+}
+
+int main() {
+	int sizes[] = { 10, 100, 1000 };
+
+	printf("%8s %16s %16s\n", "clients", "malloc+walk ns", "pool+tail ns");
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		double base = churn(sizes[i], False);
+		double pool = churn(sizes[i], True);
+		printf("%8d %16.1f %16.1f\n", sizes[i], base, pool);
+	}
+
+	int policysizes[] = { 100, 1000, 10000 };
+
+	printf("\n%8s %16s %16s %16s %16s\n", "clients", "policy ns", "requests/op", "switch ns", "requests/switch");
+	for (size_t i = 0; i < LENGTH(policysizes); i++) {
+		unsigned long requests, switchrequests;
+		double ns = policy(policysizes[i], &requests);
+		double switchns = switching(policysizes[i], &switchrequests);
+		printf("%8d %16.1f %16.2f %16.1f %16.2f\n", policysizes[i], ns, (double)requests / POLICY_OPS,
+			switchns, (double)switchrequests / SWITCH_OPS);
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../util.h"
+#include "../wintab.h"
+#include "../core.h"
+#include "mock.h"
+
+// what the server would know about a window, indexed by its id, windows
+// start out mapped since iwm only manages what was mapped
+typedef struct MockWin MockWin;
+struct MockWin {
+	Bool unmapped;
+	Bool configured;
+	int x, y, w, h;
+};
+
+unsigned long mockcount[MockOps];
+const char *mockopnames[MockOps] = {
+	[MockConfigure] = "configure",
+	[MockMap] = "map",
+	[MockUnmap] = "unmap",
+	[MockRaise] = "raise",
+	[MockFocus] = "focus",
+	[MockDrawbar] = "drawbar",
+};
+
+static MockReq *reqlog = NULL;
+static int logsize = 0;
+static unsigned long logged = 0;
+static MockWin *wins = NULL;
+static size_t nwins = 0;
+static Window focused = None;
+static Monitor *monitors = NULL;
+static Bar *bars = NULL;
+
+static MockWin *mockwin(Window wnd) {
+	if (wnd >= nwins) {
+		size_t n = nwins ? nwins : 1024;
+		while (n <= wnd) {
+			n *= 2;
+		}
+		wins = realloc(wins, n * sizeof(MockWin));
+		if (wins == NULL) {
+			panic("Could not allocate mock windows...");
+		}
+		memset(wins + nwins, 0, (n - nwins) * sizeof(MockWin));
+		nwins = n;
+	}
+	return &wins[wnd];
+}
+
+static void record(int op, Window wnd) {
+	mockcount[op]++;
+	if (logsize > 0) {
+		reqlog[logged % logsize] = (MockReq){ op, wnd };
+	}
+	logged++;
+}
+
+static void mockconfigure(Client *c) {
+	MockWin *w = mockwin(c->wnd);
+	w->configured = True;
+	w->x = c->x;
+	w->y = c->y;
+	w->w = c->w;
+	w->h = c->h;
+	record(MockConfigure, c->wnd);
+}
+
+static void mockmap(Client *c) {
+	mockwin(c->wnd)->unmapped = False;
+	record(MockMap, c->wnd);
+}
+
+static void mockunmap(Client *c) {
+	mockwin(c->wnd)->unmapped = True;
+	record(MockUnmap, c->wnd);
+}
+
+static void mockraise(Client *c) {
+	record(MockRaise, c->wnd);
+}
+
+static void mockfocus(Client *c) {
+	focused = c != NULL ? c->wnd : None;
+	record(MockFocus, focused);
+}
+
+static void mockdrawbar(Monitor *m, int dirty) {
+	(void)dirty;
+	record(MockDrawbar, m->statusbar->wnd);
+}
+
+const Backend mockbackend = { mockconfigure, mockmap, mockunmap, mockraise, mockfocus, mockdrawbar };
+
+void mockinit(int nmons, int w, int h, int size) {
+	static Bool pooled = False;
+	if (!pooled) {
+		poolinit(&clientpool, sizeof(Client), 64);
+		pooled = True;
+	}
+	backend = &mockbackend;
+
+	free(monitors);
+	free(bars);
+	monitors = calloc(nmons, sizeof(Monitor));
+	bars = calloc(nmons, sizeof(Bar));
+	if (monitors == NULL || bars == NULL) {
+		panic("Could not allocate mock monitors...");
+	}
+	for (int i = 0; i < nmons; i++) {
+		Monitor *m = &monitors[i];
+		m->posx = i * w;
+		m->width = w;
+		m->height = h;
+		m->bar = True;
+		m->statusbar = &bars[i];
+		bars[i].height = 35;
+		// bar windows get ids no client uses
+		bars[i].wnd = (Window)-1 - i;
+		initws(m);
+		m->prev = i > 0 ? &monitors[i - 1] : NULL;
+		m->next = i + 1 < nmons ? &monitors[i + 1] : NULL;
+	}
+	mons = fmon = &monitors[0];
+
+	free(reqlog);
+	reqlog = NULL;
+	logsize = size;
+	if (size > 0) {
+		reqlog = malloc(size * sizeof(MockReq));
+		if (reqlog == NULL) {
+			panic("Could not allocate mock request log...");
+		}
+	}
+	mockreset();
+}
+
+void mockreset() {
+	memset(mockcount, 0, sizeof(mockcount));
+	logged = 0;
+}
+
+int mocklog(MockReq *out, int max) {
+	unsigned long n = logged < (unsigned long)logsize ? logged : (unsigned long)logsize;
+	if (n > (unsigned long)max) {
+		n = max;
+	}
+	for (unsigned long i = 0; i < n; i++) {
+		out[i] = reqlog[(logged - n + i) % logsize];
+	}
+	return n;
+}
+
+const char *mockcheck(Bool settled) {
+	static char err[128];
+	Bool found = False;
+
+	for (Monitor *m = mons; m != NULL; m = m->next) {
+		found |= m == fmon;
+		if (m->sel < m->ws || m->sel >= m->ws + NWORKSPACES) return "selected workspace not on its monitor";
+
+		for (Workspace *ws = m->ws; ws < m->ws + NWORKSPACES; ws++) {
+			if (ws->mon != m) return "workspace on the wrong monitor";
+
+			Client *prev = NULL;
+			Bool hasfocused = ws->focused == NULL;
+			for (Client *c = ws->clients; c != NULL; c = c->next) {
+				if (c->prev != prev) return "broken prev link";
+				if (c->mon != m) return "client on the wrong monitor";
+				if (c->ws != ws) return "client on the wrong workspace";
+				WinEntry *e = wtlookup(c->wnd);
+				if (e == NULL || e->client != c) return "client missing from the window index";
+				hasfocused |= c == ws->focused;
+				prev = c;
+			}
+			if (ws->tail != prev) return "stale tail";
+			if (!hasfocused) return "focused client not on its workspace";
+			if (!settled) continue;
+
+			if ((ws->focused == NULL) != (ws->clients == NULL)) return "workspace with clients but no focus";
+
+			int x, y, w, h;
+			monarea(m, &x, &y, &w, &h);
+			for (Client *c = ws->clients; c != NULL; c = c->next) {
+				MockWin *mw = mockwin(c->wnd);
+				if (!mw->configured || mw->x != x || mw->y != y || mw->w != w || mw->h != h) {
+					snprintf(err, sizeof(err), "client %lu not covering its monitor", c->wnd);
+					return err;
+				}
+				if (mw->unmapped != c->hidden) {
+					snprintf(err, sizeof(err), "client %lu mapped state out of sync", c->wnd);
+					return err;
+				}
+				Bool visible = ws == m->sel && (!hideclients || c == ws->focused);
+				if (c->hidden == visible) {
+					snprintf(err, sizeof(err), "client %lu %s", c->wnd, c->hidden ? "visible but hidden" : "covered but shown");
+					return err;
+				}
+			}
+		}
+		if (!settled) continue;
+
+		if (m->dirty != 0) return "dirty monitor after applydirty";
+		if (hideclients && m->shown != m->sel->focused) return "shown is not the focused client";
+	}
+	if (!found) return "focused monitor not in the list";
+	if (settled && focused != (fmon->sel->focused != NULL ? fmon->sel->focused->wnd : None)) {
+		return "input focus out of sync";
+	}
+	return NULL;
+}
@@ -0,0 +1,34 @@
+#ifndef MOCK_H
+#define MOCK_H
+
+#include "../iwm.h"
+#include "../core.h"
+
+// in-memory display for core.c, it records every request instead of
+// talking to a server, so the state machine runs without X
+enum { MockConfigure, MockMap, MockUnmap, MockRaise, MockFocus, MockDrawbar, MockOps };
+
+typedef struct MockReq MockReq;
+struct MockReq {
+	int op;
+	Window wnd;
+};
+
+extern const Backend mockbackend;
+// requests per op since the last mockreset
+extern unsigned long mockcount[MockOps];
+extern const char *mockopnames[MockOps];
+
+// set up nmons side by side monitors of w x h with the bar shown, record
+// the last logsize requests, 0 to only count them
+void mockinit(int nmons, int w, int h, int logsize);
+void mockreset();
+// copy the last max recorded requests to out, oldest first, returns how
+// many there were
+int mocklog(MockReq *out, int max);
+// walk every monitor and client and check what core.c promises, returns a
+// description of the first broken invariant or NULL, settled says that
+// applydirty ran since the last change
+const char *mockcheck(Bool settled);
+
+#endif
@@ -0,0 +1,95 @@
+// the _IWM_BENCH exchange shared by the benchmark tools
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "probe.h"
+
+static Window probewnd;
+static Atom benchatom;
+
+double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void die(const char *prog, const char *msg) {
+	fprintf(stderr, "%s: %s\n", prog, msg);
+	exit(EXIT_FAILURE);
+}
+
+void waitx(Display *dpy, double timeout) {
+	struct pollfd pfd = { ConnectionNumber(dpy), POLLIN, 0 };
+	if (timeout < 0) timeout = 0;
+	poll(&pfd, 1, (int)(timeout * 1000));
+}
+
+void probeinit(Display *dpy) {
+	benchatom = XInternAtom(dpy, "_IWM_BENCH", False);
+	// never mapped, only receives the replies
+	probewnd = XCreateSimpleWindow(dpy, DefaultRootWindow(dpy), 0, 0, 1, 1, 0, 0, 0);
+	XSelectInput(dpy, probewnd, PropertyChangeMask);
+}
+
+static Bool isreply(Display *d, XEvent *ev, XPointer arg) {
+	(void)d;
+	(void)arg;
+	return ev->type == PropertyNotify && ev->xproperty.window == probewnd
+		&& ev->xproperty.atom == benchatom && ev->xproperty.state == PropertyNewValue;
+}
+
+Stats probe(Display *dpy, void (*other)(XEvent *ev)) {
+	XEvent ev;
+	Stats s = { 0, 0, 0, 0 };
+
+	for (int tries = 0; tries < 20; tries++) {
+		memset(&ev, 0, sizeof(ev));
+		ev.xclient.type = ClientMessage;
+		ev.xclient.window = DefaultRootWindow(dpy);
+		ev.xclient.message_type = benchatom;
+		ev.xclient.format = 32;
+		ev.xclient.data.l[0] = probewnd;
+		XSendEvent(dpy, DefaultRootWindow(dpy), False, SubstructureRedirectMask|SubstructureNotifyMask, &ev);
+		XFlush(dpy);
+
+		double deadline = now() + 0.5;
+		while (now() < deadline) {
+			// keep the other events coming in while we wait, the reply may be
+			// behind any of them
+			Bool got = XCheckIfEvent(dpy, &ev, isreply, NULL);
+			while (!got && XPending(dpy)) {
+				XEvent e;
+				XNextEvent(dpy, &e);
+				if (other != NULL) {
+					other(&e);
+				}
+				got = XCheckIfEvent(dpy, &ev, isreply, NULL);
+			}
+			if (got) {
+				Atom type;
+				int format;
+				unsigned long n, after;
+				unsigned char *data = NULL;
+
+				s.time = now();
+				if (XGetWindowProperty(dpy, probewnd, benchatom, 0, 3, False, XA_CARDINAL,
+						&type, &format, &n, &after, &data) != Success || n != 3) {
+					die("probe", "malformed reply from the wm");
+				}
+				long *l = (long *)data;
+				s.events = l[0];
+				s.requests = l[1];
+				s.redraws = l[2];
+				XFree(data);
+				return s;
+			}
+			waitx(dpy, deadline - now());
+		}
+	}
+	die("probe", "no reply from the wm, is it running with -DBENCH?");
+	return s;
+}
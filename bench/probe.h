@@ -0,0 +1,24 @@
+#ifndef PROBE_H
+#define PROBE_H
+
+#include <X11/Xlib.h>
+
+// counters of an iwm built with -DBENCH, as of the moment it answered
+typedef struct {
+	unsigned long events;
+	unsigned long requests;
+	unsigned long redraws;
+	double time;
+} Stats;
+
+double now();
+void die(const char *prog, const char *msg);
+// wait up to timeout seconds for the connection to become readable
+void waitx(Display *dpy, double timeout);
+void probeinit(Display *dpy);
+// ask the wm for its counters, the reply only comes after everything sent
+// before the question was handled, so this doubles as a barrier, events
+// that arrive meanwhile go to other, or are dropped when it is NULL
+Stats probe(Display *dpy, void (*other)(XEvent *ev));
+
+#endif
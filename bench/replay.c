@@ -0,0 +1,237 @@
+// plays an iwm event trace (see trace.h) back against an iwm built with
+// -DBENCH (see replay.sh)
+//
+// the trace holds what iwm saw, replay redoes what the clients did to make
+// it see that: stub windows are created, mapped, configured, retitled,
+// unmapped and destroyed, and key presses are faked with XTest, so iwm
+// handles the same sequence again and its counters can be compared
+// between builds
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/Xatom.h>
+#include <X11/extensions/XTest.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../trace.h"
+#include "probe.h"
+
+static Display *dpy;
+static Window root;
+static XContext ctx;
+static double speed = 1;
+static Window tracedroot;
+static unsigned long nstubs = 0;
+static unsigned long nretitles = 0;
+
+static void usage() {
+	die("replay", "usage: replay [-s speed, 0 for as fast as possible] trace");
+}
+
+// the stub standing in for a window of the recorded session
+static Window stub(Window w, Bool create, Bool override) {
+	XPointer data;
+	if (XFindContext(dpy, w, ctx, &data) == 0) {
+		return (Window)data;
+	}
+	if (!create) {
+		return None;
+	}
+
+	XSetWindowAttributes attr;
+	attr.override_redirect = override;
+	Window s = XCreateWindow(dpy, root, 0, 0, 100, 100, 0, CopyFromParent, InputOutput,
+		CopyFromParent, CWOverrideRedirect, &attr);
+	XSaveContext(dpy, w, ctx, (XPointer)s);
+	nstubs++;
+	return s;
+}
+
+static void retitle(Window w) {
+	char name[32];
+	snprintf(name, sizeof(name), "replay %lu", nretitles++);
+	XStoreName(dpy, w, name);
+}
+
+// hold the modifiers of state down around the key
+static void fakekey(unsigned int keycode, unsigned int state) {
+	XModifierKeymap *map = XGetModifierMapping(dpy);
+	for (int pass = 0; pass < 2; pass++) {
+		if (pass == 1) {
+			XTestFakeKeyEvent(dpy, keycode, True, 0);
+			XTestFakeKeyEvent(dpy, keycode, False, 0);
+		}
+		for (int m = 0; m < 8; m++) {
+			KeyCode mod = map->modifiermap[m * map->max_keypermod];
+			if ((state & (1 << m)) && mod != 0) {
+				XTestFakeKeyEvent(dpy, mod, pass == 0, 0);
+			}
+		}
+	}
+	XFreeModifiermap(map);
+}
+
+// returns whether anything was sent
+static int replay(TraceRec *r) {
+	XEvent *ev = &r->ev;
+	Window s;
+
+	if (r->flags & TraceOwn) {
+		return 0;
+	}
+
+	switch (ev->type) {
+	case CreateNotify:
+		stub(ev->xcreatewindow.window, True, ev->xcreatewindow.override_redirect);
+		return 1;
+	case MapRequest:
+		XMapWindow(dpy, stub(ev->xmaprequest.window, True, False));
+		return 1;
+	case MapNotify:
+		// mapping a managed window is the answer to a MapRequest
+		if (!ev->xmap.override_redirect) return 0;
+		XMapWindow(dpy, stub(ev->xmap.window, True, True));
+		return 1;
+	case UnmapNotify:
+		if (r->flags & TraceExpected) return 0;
+		if ((s = stub(ev->xunmap.window, False, False)) == None) return 0;
+		if (ev->xunmap.send_event) {
+			// a hidden client withdrawing, ICCCM 4.1.4
+			XEvent ue;
+			memset(&ue, 0, sizeof(ue));
+			ue.xunmap.type = UnmapNotify;
+			ue.xunmap.event = root;
+			ue.xunmap.window = s;
+			XSendEvent(dpy, root, False, SubstructureRedirectMask|SubstructureNotifyMask, &ue);
+		} else {
+			XUnmapWindow(dpy, s);
+		}
+		return 1;
+	case DestroyNotify:
+		if ((s = stub(ev->xdestroywindow.window, False, False)) == None) return 0;
+		XDestroyWindow(dpy, s);
+		XDeleteContext(dpy, ev->xdestroywindow.window, ctx);
+		return 1;
+	case ConfigureRequest: {
+		XWindowChanges wc;
+		wc.x = ev->xconfigurerequest.x;
+		wc.y = ev->xconfigurerequest.y;
+		wc.width = ev->xconfigurerequest.width;
+		wc.height = ev->xconfigurerequest.height;
+		wc.border_width = ev->xconfigurerequest.border_width;
+		wc.sibling = None;
+		wc.stack_mode = ev->xconfigurerequest.detail;
+		unsigned int mask = ev->xconfigurerequest.value_mask & ~CWSibling;
+		XConfigureWindow(dpy, stub(ev->xconfigurerequest.window, True, False), mask, &wc);
+		return 1;
+	}
+	case PropertyNotify:
+		// WM_NAME is predefined, the only atom that means the same on both
+		// servers, and the only one iwm cares about
+		if (ev->xproperty.atom != XA_WM_NAME) return 0;
+		if (ev->xproperty.window == tracedroot) {
+			retitle(root);
+		} else if ((s = stub(ev->xproperty.window, False, False)) != None) {
+			retitle(s);
+		} else {
+			return 0;
+		}
+		return 1;
+	case KeyPress:
+		fakekey(ev->xkey.keycode, ev->xkey.state);
+		return 1;
+	}
+	// everything else iwm caused itself or only reacts to its own requests
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	const char *path = NULL;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-s") && i + 1 < argc) speed = atof(argv[++i]);
+		else if (path == NULL && argv[i][0] != '-') path = argv[i];
+		else usage();
+	}
+	if (path == NULL || speed < 0) usage();
+
+	FILE *f = fopen(path, "r");
+	if (f == NULL) {
+		die("replay", "could not open the trace");
+	}
+	TraceHeader h;
+	if (fread(&h, sizeof(h), 1, f) != 1 || memcmp(h.magic, TRACE_MAGIC, sizeof(h.magic)) != 0) {
+		die("replay", "not an iwm trace");
+	}
+	if (h.version != TRACE_VERSION || h.evsize != sizeof(XEvent)) {
+		die("replay", "trace recorded by an incompatible iwm");
+	}
+
+	tracedroot = h.root;
+
+	if ((dpy = XOpenDisplay(NULL)) == NULL) {
+		die("replay", "could not open display");
+	}
+	int evbase, errbase, major, minor;
+	if (!XTestQueryExtension(dpy, &evbase, &errbase, &major, &minor)) {
+		die("replay", "the server has no XTEST");
+	}
+	root = DefaultRootWindow(dpy);
+	ctx = XUniqueContext();
+	probeinit(dpy);
+	if ((int)h.width != DisplayWidth(dpy, DefaultScreen(dpy)) || (int)h.height != DisplayHeight(dpy, DefaultScreen(dpy))) {
+		fprintf(stderr, "replay: trace was recorded on a %ux%u root, layouts will differ\n", h.width, h.height);
+	}
+
+	Stats s0 = probe(dpy, NULL);
+
+	TraceRec r;
+	unsigned long nrecords = 0, nsent = 0;
+	unsigned long recrequests = 0;
+	double rechandler = 0;
+	double start = now();
+	while (fread(&r, sizeof(r), 1, f) == 1) {
+		nrecords++;
+		recrequests += r.requests;
+		rechandler += r.handlerns / 1e9;
+
+		if (speed > 0) {
+			double due = start + r.ns / 1e9 / speed;
+			XFlush(dpy);
+			while (now() < due) {
+				usleep((due - now()) * 1e6);
+			}
+		}
+		if (replay(&r)) {
+			nsent++;
+			// keep a fast replay from running too far ahead of the wm
+			if (speed == 0 && nsent % 64 == 0) {
+				XSync(dpy, False);
+			}
+		}
+		// nobody reads these, keep the queue short
+		while (XPending(dpy)) {
+			XEvent e;
+			XNextEvent(dpy, &e);
+		}
+	}
+	fclose(f);
+	XSync(dpy, False);
+
+	Stats s1 = probe(dpy, NULL);
+
+	// every probe costs the wm one event and one request for the reply
+	printf("trace events:           %lu\n", nrecords);
+	printf("replayed actions:       %lu on %lu stub windows\n", nsent, nstubs);
+	printf("recorded handler time:  %.3f ms\n", rechandler * 1e3);
+	printf("recorded requests:      %lu\n", recrequests);
+	printf("wm events:              %lu\n", s1.events - s0.events - 1);
+	printf("wm requests:            %lu\n", s1.requests - s0.requests - 1);
+	printf("wm redraws:             %lu\n", s1.redraws - s0.redraws);
+	printf("replay time:            %.3f s\n", s1.time - start);
+	printf("wm events/s:            %.0f\n", (s1.events - s0.events - 1) / (s1.time - start));
+
+	XCloseDisplay(dpy);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,27 @@
+#!/bin/sh
+# trace replay: starts Xvfb with two xinerama screens and a -DBENCH build of
+# iwm, then plays a trace recorded with IWM_TRACE=file back against it,
+# arguments are passed on to bench/replay
+
+cd "$(dirname "$0")/.."
+
+DPY=${BENCH_DISPLAY:-:97}
+SCREEN=${BENCH_SCREEN:-1280x800x24}
+
+command -v Xvfb >/dev/null || { echo "replay: Xvfb not found" >&2; exit 1; }
+
+Xvfb "$DPY" +xinerama -screen 0 "$SCREEN" -screen 1 "$SCREEN" -nolisten tcp >/dev/null 2>&1 &
+xvfb=$!
+trap 'kill $wm $xvfb 2>/dev/null' EXIT INT TERM
+
+# wait for the server socket
+for i in $(seq 50); do
+	[ -e "/tmp/.X11-unix/X${DPY#:}" ] && break
+	sleep 0.1
+done
+
+DISPLAY=$DPY ./bench/iwm-bench >/dev/null 2>&1 &
+wm=$!
+
+# the first probe waits until the wm answers
+DISPLAY=$DPY ./bench/replay "$@"
@@ -0,0 +1,164 @@
+// synthetic client generator for the benchmark harness, run against an
+// iwm built with -DBENCH (see bench.sh)
+//
+// it maps windows at a fixed rate and times each one from XMapWindow until
+// the ConfigureNotify that gives it its final size, retitles them at a fixed
+// rate and finally unmaps them all, asking the wm for its counters between
+// the phases
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/Xatom.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "probe.h"
+
+static Display *dpy;
+static Window root;
+static XContext ctx;
+
+static int nwindows = 100;
+static double maprate = 50;
+static double titlerate = 200;
+static double titletime = 2;
+
+static Window *wins;
+static double *mapped;
+static double *latency;
+static int nconfigured = 0;
+
+// the first ConfigureNotify that grows a window is the wm placing it
+static void handle(XEvent *ev) {
+	if (ev->type != ConfigureNotify) return;
+
+	XPointer data;
+	if (XFindContext(dpy, ev->xconfigure.window, ctx, &data) != 0) return;
+
+	long i = (long)data;
+	if (latency[i] < 0 && ev->xconfigure.width > 1) {
+		latency[i] = now() - mapped[i];
+		nconfigured++;
+	}
+}
+
+// process whatever is queued, waiting at most until deadline
+static void pump(double deadline) {
+	do {
+		while (XPending(dpy)) {
+			XEvent ev;
+			XNextEvent(dpy, &ev);
+			handle(&ev);
+		}
+		double left = deadline - now();
+		if (left <= 0) break;
+		waitx(dpy, left);
+	} while (now() < deadline);
+}
+
+static Stats stats() {
+	return probe(dpy, handle);
+}
+
+static int cmpdouble(const void *a, const void *b) {
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+static void usage() {
+	die("xgen", "usage: xgen [-n windows] [-m maps/s] [-t retitles/s] [-d retitle seconds]");
+}
+
+int main(int argc, char *argv[]) {
+	for (int i = 1; i < argc; i++) {
+		if (i + 1 >= argc) usage();
+		if (!strcmp(argv[i], "-n")) nwindows = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-m")) maprate = atof(argv[++i]);
+		else if (!strcmp(argv[i], "-t")) titlerate = atof(argv[++i]);
+		else if (!strcmp(argv[i], "-d")) titletime = atof(argv[++i]);
+		else usage();
+	}
+	if (nwindows <= 0 || maprate <= 0 || titlerate <= 0) usage();
+
+	if ((dpy = XOpenDisplay(NULL)) == NULL) {
+		die("xgen", "could not open display");
+	}
+	root = DefaultRootWindow(dpy);
+	ctx = XUniqueContext();
+	probeinit(dpy);
+
+	wins = malloc(nwindows * sizeof(Window));
+	mapped = malloc(nwindows * sizeof(double));
+	latency = malloc(nwindows * sizeof(double));
+	if (wins == NULL || mapped == NULL || latency == NULL) {
+		die("xgen", "out of memory");
+	}
+
+	for (long i = 0; i < nwindows; i++) {
+		char name[32];
+		wins[i] = XCreateSimpleWindow(dpy, root, 0, 0, 1, 1, 0, 0, 0);
+		XSelectInput(dpy, wins[i], StructureNotifyMask);
+		snprintf(name, sizeof(name), "xgen %ld", i);
+		XStoreName(dpy, wins[i], name);
+		XSaveContext(dpy, wins[i], ctx, (XPointer)i);
+		latency[i] = -1;
+	}
+
+	Stats s0 = stats();
+
+	// map phase
+	double start = now();
+	for (int i = 0; i < nwindows; i++) {
+		mapped[i] = now();
+		XMapWindow(dpy, wins[i]);
+		XFlush(dpy);
+		pump(start + (i + 1) / maprate);
+	}
+	double deadline = now() + 10;
+	while (nconfigured < nwindows && now() < deadline) {
+		pump(now() + 0.05);
+	}
+	Stats s1 = stats();
+
+	// retitle phase
+	int nretitles = (int)(titlerate * titletime);
+	start = now();
+	for (int i = 0; i < nretitles; i++) {
+		char name[32];
+		snprintf(name, sizeof(name), "xgen %d: %d", i % nwindows, i);
+		XStoreName(dpy, wins[i % nwindows], name);
+		XFlush(dpy);
+		pump(start + (i + 1) / titlerate);
+	}
+	Stats s2 = stats();
+
+	// unmap phase
+	for (int i = 0; i < nwindows; i++) {
+		XUnmapWindow(dpy, wins[i]);
+	}
+	XFlush(dpy);
+	Stats s3 = stats();
+
+	// every stats() costs the wm one request for the reply
+	int nlat = 0;
+	for (int i = 0; i < nwindows; i++) {
+		if (latency[i] >= 0) latency[nlat++] = latency[i];
+	}
+	qsort(latency, nlat, sizeof(double), cmpdouble);
+
+	printf("windows managed:        %d/%d\n", nlat, nwindows);
+	if (nlat > 0) {
+		printf("map latency p50:        %.3f ms\n", latency[nlat / 2] * 1e3);
+		printf("map latency p99:        %.3f ms\n", latency[(nlat * 99) / 100] * 1e3);
+	}
+	printf("requests per window:    %.2f\n", (double)(s1.requests - s0.requests - 1) / nwindows);
+	printf("redraws per window:     %.2f\n", (double)(s1.redraws - s0.redraws) / nwindows);
+	printf("retitle events/s:       %.0f\n", (s2.events - s1.events - 1) / (s2.time - start));
+	printf("retitle redraws:        %lu for %d titles\n", s2.redraws - s1.redraws, nretitles);
+	printf("unmap requests/window:  %.2f\n", (double)(s3.requests - s2.requests - 1) / nwindows);
+	printf("events handled/s:       %.0f\n", (s3.events - s0.events) / (s3.time - s0.time));
+
+	XCloseDisplay(dpy);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,301 @@
+#include <stddef.h>
+#include "log.h"
+#include "list.h"
+#include "wintab.h"
+#include "core.h"
+
+const Backend *backend = NULL;
+Monitor *mons = NULL;
+Monitor *fmon = NULL;
+Pool clientpool;
+
+Client *addclient(Window wnd, Monitor *m) {
+	Client *c = poolalloc(&clientpool);
+	c->wnd = wnd;
+	c->mon = NULL;
+	c->name[0] = '\0';
+	c->fitw = -1;
+	c->titledirty = False;
+	c->hidden = False;
+	c->ignoreunmap = 0;
+	c->unmapserial = 0;
+	c->x = c->y = c->w = c->h = 0;
+
+	pushclient(c, m->sel);
+	wtinsert(c->wnd, c, NULL);
+	focus(c);
+	return c;
+}
+
+// take a client out of its workspace, the focus goes to a neighbour
+static void detach(Client *c) {
+	Workspace *w = c->ws;
+
+	if (w->focused == c) {
+		w->focused = c->prev != NULL ? c->prev : c->next;
+		if (w == c->mon->sel) {
+			setdirty(c->mon, DirtyFocus|DirtyBar);
+		}
+	}
+	ripclient(c, w);
+}
+
+void delclient(Client *c) {
+	Monitor *m = c->mon;
+
+	if (m->shown == c) {
+		m->shown = NULL;
+	}
+
+	detach(c);
+	wtremove(c->wnd);
+	poolfree(&clientpool, c);
+
+	setdirty(m, DirtyBar);
+}
+
+void focus(Client *c) {
+	if (c == NULL || c->mon == NULL) {
+		return;
+	}
+	LOG(LogDebug, "focusing %lu", c->wnd);
+
+	// a client on another workspace brings it along
+	selectws(c->mon, c->ws);
+
+	// updatefocus only hides the client it showed last, one that got and
+	// lost the focus within the same batch, a new window mapped right
+	// before another, would stay mapped behind the new one
+	Client *old = c->ws->focused;
+	if (hideclients && old != NULL && old != c && old != c->mon->shown) {
+		hideclient(old);
+	}
+
+	c->ws->focused = c;
+	setdirty(c->mon, DirtyFocus|DirtyBar);
+}
+
+void focusmon(Monitor *m) {
+	if (m == NULL) {
+		return;
+	}
+
+	Monitor *prev_monitor = fmon;
+	fmon = m;
+
+	// an empty monitor gives the input focus to the root in updatefocus, the
+	// one we left keeps its focused client for when we come back
+	if (m->sel->focused != NULL) {
+		focus(m->sel->focused);
+	} else if (m->sel->clients != NULL) {
+		focus(m->sel->clients);
+	}
+	// the input focus moves even if neither monitor changed its client
+	setdirty(prev_monitor, DirtyBar);
+	setdirty(fmon, DirtyFocus|DirtyBar);
+}
+
+// move a client to the end of the selected workspace of another monitor
+void sendmon(Client *c, Monitor *m) {
+	if (c == NULL || m == NULL || c->mon == m) return;
+
+	Monitor *from = c->mon;
+	detach(c);
+
+	if (m->sel->focused == NULL) {
+		m->sel->focused = c;
+	}
+
+	pushclient(c, m->sel);
+
+	setdirty(from, DirtyLayout);
+	setdirty(m, DirtyLayout);
+}
+
+// move a client to the end of another workspace of its monitor
+void sendws(Client *c, Workspace *w) {
+	if (c == NULL || w == NULL || c->ws == w) return;
+
+	Monitor *m = c->mon;
+	detach(c);
+
+	if (w->focused == NULL) {
+		w->focused = c;
+	}
+
+	pushclient(c, w);
+
+	// updatefocus takes care of the client it showed last
+	if (w != m->sel && c != m->shown) {
+		hideclient(c);
+	} else if (w == m->sel && !hideclients) {
+		showclient(c);
+	}
+	setdirty(m, DirtyFocus|DirtyBar);
+}
+
+// put another workspace on screen, with hideclients this maps its focused
+// client and unmaps the one that was shown, however many clients either has
+void selectws(Monitor *m, Workspace *w) {
+	if (m->sel == w) return;
+
+	Workspace *old = m->sel;
+	m->sel = w;
+	if (hideclients) {
+		setdirty(m, DirtyFocus|DirtyBar);
+		return;
+	}
+	for (Client *c = old->clients; c != NULL; c = c->next) {
+		hideclient(c);
+	}
+	for (Client *c = w->clients; c != NULL; c = c->next) {
+		showclient(c);
+	}
+	setdirty(m, DirtyFocus|DirtyBar);
+}
+
+void initws(Monitor *m) {
+	for (int i = 0; i < NWORKSPACES; i++) {
+		m->ws[i].clients = NULL;
+		m->ws[i].tail = NULL;
+		m->ws[i].focused = NULL;
+		m->ws[i].mon = m;
+	}
+	m->sel = &m->ws[0];
+	m->shown = NULL;
+}
+
+// move every client of a monitor that is going away to the end of the same
+// workspace of another
+void evacuate(Monitor *m, Monitor *to) {
+	for (int i = 0; i < NWORKSPACES; i++) {
+		Workspace *w = &m->ws[i];
+		Workspace *tw = &to->ws[i];
+		while (w->clients != NULL) {
+			Client *c = w->clients;
+			ripclient(c, w);
+			pushclient(c, tw);
+		}
+		if (tw->focused == NULL) {
+			tw->focused = tw->clients;
+		}
+	}
+	if (fmon == m) {
+		fmon = to;
+		setdirty(to, DirtyFocus);
+	}
+	setdirty(to, DirtyLayout|DirtyBar);
+}
+
+void setdirty(Monitor *m, int flags) {
+	if (m == NULL) return;
+	m->dirty |= flags;
+}
+
+// the part of a monitor clients get, everything but the bar
+void monarea(Monitor *m, int *x, int *y, int *w, int *h) {
+	*x = m->posx;
+	*w = m->width;
+	if (m->bar) {
+		*y = m->posy + m->statusbar->height;
+		*h = m->height - m->statusbar->height;
+	} else {
+		*y = m->posy;
+		*h = m->height;
+	}
+}
+
+// move and resize a client unless it is there already, stacking is left to
+// refresh, which raises only the focused window
+Bool configclient(Client *c, int x, int y, int w, int h) {
+	if (c->x == x && c->y == y && c->w == w && c->h == h) {
+		return False;
+	}
+
+	c->x = x;
+	c->y = y;
+	c->w = w;
+	c->h = h;
+	backend->configure(c);
+	return True;
+}
+
+void showclient(Client *c) {
+	if (!c->hidden) return;
+	c->hidden = False;
+	backend->map(c);
+}
+
+// the UnmapNotify this causes must not unmanage it, see unmapnotify
+void hideclient(Client *c) {
+	if (c->hidden) return;
+	c->hidden = True;
+	backend->unmap(c);
+}
+
+// updatewm became updatemon, because we have more than one monitor(screen)
+void updatemon(Monitor *m) {
+	if (m == NULL) return;
+
+	int x, y, w, h;
+	monarea(m, &x, &y, &w, &h);
+
+	// most clients are already where they belong, only the ones that moved
+	// in or saw the area change get a configure, clients of the other
+	// workspaces too, so selecting one never has to
+	for (Workspace *ws = m->ws; ws < m->ws + NWORKSPACES; ws++) {
+		if (ws->focused == NULL) {
+			ws->focused = ws->clients;
+		}
+
+		// updatefocus shows the focused one
+		for (Client *c = ws->clients; c != NULL; c = c->next) {
+			configclient(c, x, y, w, h);
+			if (ws != m->sel || (hideclients && c != ws->focused)) {
+				hideclient(c);
+			} else if (!hideclients) {
+				showclient(c);
+			}
+		}
+	}
+	// clients that came from another monitor may be stacked above focused
+	m->dirty |= DirtyFocus|DirtyBar;
+}
+
+void updatefocus(Monitor *m) {
+	Client *f = m->sel->focused;
+	if (f != NULL) {
+		showclient(f);
+		backend->raise(f);
+	}
+	// mapped before the old one goes away, so nothing flashes, and a
+	// focus or workspace change costs the same however many clients
+	// there are
+	if (hideclients) {
+		if (m->shown != NULL && m->shown != f && m->shown->mon == m) {
+			hideclient(m->shown);
+		}
+		m->shown = f;
+	}
+	if (m == fmon) {
+		backend->focus(f);
+	}
+}
+
+void applydirty() {
+	for (Monitor *m = mons; m != NULL; m = m->next) {
+		if (m->dirty & DirtyLayout) {
+			updatemon(m);
+		}
+	}
+
+	for (Monitor *m = mons; m != NULL; m = m->next) {
+		if (m->dirty & DirtyFocus) {
+			updatefocus(m);
+		}
+		if (m->dirty & (DirtyBar|DirtyExpose)) {
+			backend->drawbar(m, m->dirty);
+		}
+		m->dirty = 0;
+	}
+}
@@ -0,0 +1,54 @@
+#ifndef CORE_H
+#define CORE_H
+
+#include "iwm.h"
+#include "pool.h"
+
+// everything the window manager state machine asks of the display, the X
+// implementation lives in iwm.c and bench/mock.c only records the calls
+typedef struct Backend Backend;
+struct Backend {
+	// move and resize to the geometry in c->x, c->y, c->w, c->h
+	void (*configure)(Client *c);
+	// map and mark normal, or unmap and mark iconic
+	void (*map)(Client *c);
+	void (*unmap)(Client *c);
+	void (*raise)(Client *c);
+	// give the input focus to c, NULL for the root window
+	void (*focus)(Client *c);
+	// repaint the bar of m, dirty says whether it changed or only got exposed
+	void (*drawbar)(Monitor *m, int dirty);
+};
+
+extern const Backend *backend;
+extern Monitor *mons;
+extern Monitor *fmon;
+extern Pool clientpool;
+// set in the config section of iwm.c
+extern const Bool hideclients;
+
+// client lifecycle, addclient puts a new client at the end of the selected
+// workspace of m and focuses it, delclient hands the focus to a neighbour
+// and frees it
+Client *addclient(Window wnd, Monitor *m);
+void delclient(Client *c);
+
+void focus(Client *c);
+void focusmon(Monitor *m);
+void sendmon(Client *c, Monitor *m);
+void sendws(Client *c, Workspace *w);
+void selectws(Monitor *m, Workspace *w);
+void initws(Monitor *m);
+void evacuate(Monitor *m, Monitor *to);
+
+void setdirty(Monitor *m, int flags);
+void monarea(Monitor *m, int *x, int *y, int *w, int *h);
+Bool configclient(Client *c, int x, int y, int w, int h);
+void showclient(Client *c);
+void hideclient(Client *c);
+void updatemon(Monitor *m);
+void updatefocus(Monitor *m);
+// lay out, focus and draw whatever the monitors were marked dirty for
+void applydirty();
+
+#endif
@@ -0,0 +1,213 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "loop.h"
+#include "ipc.h"
+
+#define IPC_LINE 1024
+
+struct IpcConn {
+	int fd;
+	// bytes of an unfinished line
+	char buf[IPC_LINE];
+	int len;
+	// a reply could not be sent, drop the client
+	int broken;
+	IpcConn *next;
+};
+
+static int lfd = -1;
+static char sockpath[sizeof(((struct sockaddr_un *)0)->sun_path)];
+static IpcFunc linefunc = NULL;
+static IpcConn *conns = NULL;
+
+static void dropconn(IpcConn *conn) {
+	IpcConn **p = &conns;
+	while (*p != NULL && *p != conn) {
+		p = &(*p)->next;
+	}
+	if (*p != NULL) {
+		*p = conn->next;
+	}
+	loopdelfd(conn->fd);
+	close(conn->fd);
+	free(conn);
+}
+
+// every complete line is handled before returning, the main loop redraws
+// only after that, so the commands of one line take effect together
+static void readconn(int fd, void *arg) {
+	IpcConn *conn = arg;
+	ssize_t n = read(fd, conn->buf + conn->len, sizeof(conn->buf) - conn->len);
+	if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+		return;
+	}
+	if (n <= 0) {
+		dropconn(conn);
+		return;
+	}
+	conn->len += n;
+
+	char *line = conn->buf;
+	char *end;
+	while (!conn->broken && (end = memchr(line, '\n', conn->len - (line - conn->buf))) != NULL) {
+		*end = '\0';
+		linefunc(conn, line);
+		line = end + 1;
+	}
+	conn->len -= line - conn->buf;
+	memmove(conn->buf, line, conn->len);
+
+	if (conn->len == sizeof(conn->buf)) {
+		ipcreply(conn, "error line too long");
+		conn->broken = 1;
+	}
+	if (conn->broken) {
+		dropconn(conn);
+	}
+}
+
+static void acceptconn(int fd, void *arg) {
+	(void)arg;
+	int cfd = accept4(fd, NULL, NULL, SOCK_NONBLOCK|SOCK_CLOEXEC);
+	if (cfd < 0) return;
+
+	// spawn runs shell commands, nobody but our own user gets to send them
+	struct ucred cred;
+	socklen_t credlen = sizeof(cred);
+	if (getsockopt(cfd, SOL_SOCKET, SO_PEERCRED, &cred, &credlen) < 0 || cred.uid != getuid()) {
+		close(cfd);
+		return;
+	}
+
+	IpcConn *conn = malloc(sizeof(IpcConn));
+	if (conn == NULL) {
+		close(cfd);
+		return;
+	}
+	conn->fd = cfd;
+	conn->len = 0;
+	conn->broken = 0;
+	conn->next = conns;
+	conns = conn;
+	loopaddfd(cfd, readconn, conn);
+}
+
+int ipcinit(const char *path, IpcFunc func) {
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr.sun_path)) return -1;
+	strcpy(addr.sun_path, path);
+
+	lfd = socket(AF_UNIX, SOCK_STREAM|SOCK_NONBLOCK|SOCK_CLOEXEC, 0);
+	if (lfd < 0) return -1;
+
+	// left over by a previous instance or by ourselves before a restart,
+	// anything else at a predictable path in /tmp is not ours to remove
+	struct stat st;
+	if (lstat(path, &st) == 0) {
+		if (!S_ISSOCK(st.st_mode) || st.st_uid != getuid()) {
+			close(lfd);
+			lfd = -1;
+			return -1;
+		}
+		unlink(path);
+	}
+
+	// only our user may connect, the peer check in acceptconn backs this up
+	mode_t mask = umask(077);
+	int err = bind(lfd, (struct sockaddr *)&addr, sizeof(addr));
+	umask(mask);
+	if (err < 0 || listen(lfd, 8) < 0) {
+		close(lfd);
+		lfd = -1;
+		return -1;
+	}
+	strcpy(sockpath, path);
+	linefunc = func;
+	loopaddfd(lfd, acceptconn, NULL);
+	return 0;
+}
+
+void ipcclose() {
+	while (conns != NULL) {
+		dropconn(conns);
+	}
+	if (lfd >= 0) {
+		loopdelfd(lfd);
+		close(lfd);
+		unlink(sockpath);
+		lfd = -1;
+	}
+}
+
+// replies are small and the socket buffer is large, a client that lets it
+// fill up anyway is dropped rather than blocking the wm
+void ipcreply(IpcConn *conn, const char *fmt, ...) {
+	char buf[IPC_LINE];
+	va_list ap;
+
+	if (conn->broken) return;
+
+	va_start(ap, fmt);
+	int n = vsnprintf(buf, sizeof(buf) - 1, fmt, ap);
+	va_end(ap);
+	if (n < 0) return;
+	if (n > (int)sizeof(buf) - 2) {
+		n = sizeof(buf) - 2;
+	}
+	buf[n++] = '\n';
+
+	if (send(conn->fd, buf, n, MSG_NOSIGNAL|MSG_DONTWAIT) != n) {
+		conn->broken = 1;
+	}
+}
+
+int ipcsend(const char *path, const char *msg) {
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr.sun_path)) return -1;
+	strcpy(addr.sun_path, path);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, 0);
+	if (fd < 0) return -1;
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	size_t len = strlen(msg);
+	if (write(fd, msg, len) != (ssize_t)len || write(fd, "\n", 1) != 1) {
+		close(fd);
+		return -1;
+	}
+	// iwm answers every line and hangs up once we are done sending
+	shutdown(fd, SHUT_WR);
+
+	char buf[4096];
+	// first character of the last reply line, ok or error
+	char first = '\0';
+	int atline = 1;
+	ssize_t n;
+	while ((n = read(fd, buf, sizeof(buf))) > 0) {
+		fwrite(buf, 1, n, stdout);
+		for (ssize_t i = 0; i < n; i++) {
+			if (atline) {
+				first = buf[i];
+			}
+			atline = buf[i] == '\n';
+		}
+	}
+	close(fd);
+	return first == 'o' ? 0 : -1;
+}
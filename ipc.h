@@ -0,0 +1,20 @@
+#ifndef IPC_H
+#define IPC_H
+
+// control socket, clients send commands one line at a time and get the
+// replies back on the same connection
+typedef struct IpcConn IpcConn;
+// called for every complete line, without the newline
+typedef void (*IpcFunc)(IpcConn *conn, char *line);
+
+// listen on path and register with the main loop, returns -1 on failure
+int ipcinit(const char *path, IpcFunc func);
+// remove the socket again
+void ipcclose();
+void ipcreply(IpcConn *conn, const char *fmt, ...);
+
+// client side, send msg and copy the replies to stdout, returns -1 when
+// iwm could not be reached or answered with an error
+int ipcsend(const char *path, const char *msg);
+
+#endif
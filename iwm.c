@@ -3,18 +3,37 @@
 #include <X11/Xutil.h>
 #include <X11/Xft/Xft.h>
 #include <X11/Xatom.h>
+#include <X11/Xproto.h>
 #include <X11/cursorfont.h>
 #include <X11/extensions/Xrender.h>
 #include <X11/extensions/Xinerama.h>
+#include <X11/extensions/Xrandr.h>
+#include <X11/Xlib-xcb.h>
+#include <xcb/xcb.h>
 #include <fontconfig/fontconfig.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <signal.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
 #include "util.h"
 #include "iwm.h"
+#include "wintab.h"
+#include "list.h"
+#include "pool.h"
+#include "core.h"
+#include "proc.h"
+#include "tasks.h"
+#include "loop.h"
+#include "status.h"
+#include "ipc.h"
+#include "stats.h"
+#include "log.h"
+#include "trace.h"
 
 // function declarations
 // XEvent handlers
@@ -25,48 +44,104 @@ void maprequest(XEvent *e);
 void mapnotify(XEvent *e);
 void unmapnotify(XEvent *e);
 void keypress(XEvent *e);
+void mappingnotify(XEvent *e);
 void expose(XEvent *e);
 void propertynotify(XEvent *e);
+#ifdef BENCH
+void clientmessage(XEvent *e);
+#endif
+void screenchange(XEvent *e);
 // window management
-void focus(Client *c);
-void focusmon(Monitor *m);
-void unfocus(Client *c);
-void manage(Window w);
+void manage(Window w, const char *name);
 void unmanage(Window w);
+Bool ownunmap(Client *c, XUnmapEvent *ev);
 Client *wintoclient(Window wnd);
-void updatemon(Monitor *m);
+void sendconfigure(Client *c);
+void setclientstate(Client *c, long state);
+void xconfigure(Client *c);
+void xmap(Client *c);
+void xunmap(Client *c);
+void xraise(Client *c);
+void xfocus(Client *c);
+void xdrawbar(Monitor *m, int dirty);
 void updatetitle(Client *c);
+void refresh();
+void reapchildren(int fd, void *arg);
+uint32_t traceflags(XEvent *ev);
+void initstatus();
+void statustick(void *arg);
+// control socket
+void socketpath(char *buf, size_t len);
+void ipccommand(IpcConn *conn, char *line);
+void querymonitors(IpcConn *conn);
+void queryclients(IpcConn *conn);
+void querystats(IpcConn *conn);
 // bar functions
 Bar *createbar(int width, int height, int posx, int posy);
+void destroybar(Bar *b);
+void resizebar(Bar *b, int width, int height, int posx, int posy);
 Monitor *bartomon(Bar *b);
-void updatestatus(Bar *b);
+void updatestatus();
 void updatebar(Bar *b);
-void togglebar(Bar *b);
 void setbar(Bar *b, Bool arg);
+// key actions
+void spawn(const Arg *arg);
+void quit(const Arg *arg);
+void killfocused(const Arg *arg);
+void togglebar(const Arg *arg);
+void focusstack(const Arg *arg);
+void swapstack(const Arg *arg);
+void focusmondir(const Arg *arg);
+void tagmon(const Arg *arg);
+void view(const Arg *arg);
+void tag(const Arg *arg);
+void setloglevel(const Arg *arg);
+void resetstats(const Arg *arg);
 // wm utilities
-void spawn(const char *a);
+void grabkeys();
+void updatenumlockmask();
+void initatoms();
 void termclient(Client *c);
 void killclient(Client *c);
 void init();
 void scan();
-void initmons();
+Bool loadstate();
+void savestate();
+void restorestate();
+void updategeom();
+Monitor *createmon(int posx, int posy, int width, int height);
+void detachmon(Monitor *m);
+void removemon(Monitor *m, Monitor *to);
+void free_monitor(Monitor *m);
 Monitor *wintomon(Window wnd);
-void quit(Bool arg);
 void sighup();
 void sigterm();
-// linked list utils
-Client *ripclient(Client *c, Client **head);
-void pushclient(Client *c, Client **head);
-void insertafter(Client *c, Client *o, Client **head);
-void swapnext(Client *c, Client **head);
-void swapprev(Client *c, Client **head);
+void sigusr1();
+int xerror(Display *dpy, XErrorEvent *ee);
 
 // global variables
 // state
 Bool running = True;
 Bool restart = False;
 // Bool bar = True;
+Bool statusdirty = False;
+Bool titlesdirty = False;
+// the screen layout changed, monitors get reconciled in the next refresh
+Bool geomdirty = False;
+// SIGUSR1 asks for the loop statistics on stderr
+volatile sig_atomic_t dumpstats = 0;
+// every dispatched event goes to the IWM_TRACE file
+Bool tracing = False;
+// state left by the instance that restarted into us, see restorestate
+long *state = NULL;
+unsigned long nstate = 0;
+// manage() leaves configuring to the next refresh, set while scanning
+Bool deferlayout = False;
 // consts
+#define LENGTH(X) (sizeof(X) / sizeof((X)[0]))
+#define CLEANMASK(mask) ((mask) & ~(numlockmask|LockMask) & (ShiftMask|ControlMask|Mod1Mask|Mod2Mask|Mod3Mask|Mod4Mask|Mod5Mask))
+#define MAX_BATCH 256
+#define MAX_COMMANDS 32
 #define BAR_HEIGHT 35
 #define BAR_BORDER_WIDTH 2
 #define BAR_PADDING 10
@@ -75,9 +150,29 @@ Display *dpy;
 Window root;
 int root_width;
 int root_height;
-Monitor *mons = NULL;
-Monitor *fmon = NULL;
 Cursor cursor;
+Pool monpool;
+static const Backend xbackend = { xconfigure, xmap, xunmap, xraise, xfocus, xdrawbar };
+Atom atoms[AtomLast];
+// first RandR event code, -1 without the extension
+int randrbase = -1;
+static char *atomnames[AtomLast] = {
+	[WMProtocols] = "WM_PROTOCOLS",
+	[WMDelete] = "WM_DELETE_WINDOW",
+	[WMState] = "WM_STATE",
+	[NetWMState] = "_NET_WM_STATE",
+	[NetWMStateHidden] = "_NET_WM_STATE_HIDDEN",
+	[IWMState] = "_IWM_STATE",
+#ifdef BENCH
+	[IWMBench] = "_IWM_BENCH",
+#endif
+};
+int (*xerrorxlib)(Display *, XErrorEvent *);
+// requests that block until the server replies, counted per handler in
+// the loop statistics, every call that waits for a reply is wrapped in
+// ROUNDTRIP so the count can't drift from the code
+unsigned long nroundtrips = 0;
+#define ROUNDTRIP(call) (nroundtrips++, (call))
 // XEvent handler
 void (*handler[LASTEvent]) (XEvent *) = {
 	[ConfigureRequest] = configurerequest,
@@ -87,40 +182,146 @@ void (*handler[LASTEvent]) (XEvent *) = {
 	[MapNotify] = mapnotify,
 	[UnmapNotify] = unmapnotify,
 	[KeyPress] = keypress,
+	[MappingNotify] = mappingnotify,
 	[Expose] = expose,
 	[PropertyNotify] = propertynotify,
+#ifdef BENCH
+	[ClientMessage] = clientmessage,
+#endif
 };
+#ifdef BENCH
+// counters reported to bench/xgen, see clientmessage
+unsigned long nevents = 0;
+unsigned long nredraws = 0;
+Window benchprobe = None;
+#endif
 // bar variables
 // Bar statusbar;
 const char *fontname = "Iosevka Nerd Font Mono:size=15";
 static const char *fg_color_const = "#e4e4ef";
 static const char *bg_color_const = "#2e3440";
 static const char *primary_color_const = "#88c0d0";
+// unmap every client but the focused one of each monitor, so the covered
+// ones stop drawing
+const Bool hideclients = True;
+// root window name, shared by every bar, and whether one is set
+char stext[128] = "IWM";
+Bool rootname = False;
+// built-in status modules, a root window name set with xsetroot takes over
+// from them, so does the name when no module has anything to show
+static const Bool usestatusmods = True;
+static const StatusMod statusmods[] = {
+	// function        argument             interval ms
+	{ statusload,      NULL,                5000 },
+	{ statusmem,       NULL,                5000 },
+	{ statusbattery,   "BAT0",              30000 },
+	{ statusclock,     "%a %d %b %H:%M",    1000 },
+};
+_Static_assert(LENGTH(statusmods) <= MAX_STATUSMODS, "too many status modules");
+char modtext[LENGTH(statusmods)][64];
+// Mod4 + number shows a workspace, with Shift it moves the focused client
+// there, view 1 and tag 1 do the same over the control socket
+#define WSKEYS(KEY, WS) \
+	{ Mod4Mask,                        KEY,         view,         {.i = WS} }, \
+	{ Mod4Mask|ShiftMask,              KEY,         tag,          {.i = WS} },
+#define WSCOMMANDS(NUM, WS) \
+	{ "view",       NUM,       view,         {.i = WS} }, \
+	{ "tag",        NUM,       tag,          {.i = WS} },
+// key bindings
+static const Key keys[] = {
+	// modifier                        key          function      argument
+	{ Mod4Mask,                        XK_Return,   spawn,        {.v = "alacritty"} },
+	{ Mod4Mask,                        XK_space,    spawn,        {.v = "dmenu_run"} },
+	{ Mod4Mask|ControlMask,            XK_r,        quit,         {.i = True} },
+	{ Mod4Mask|ControlMask|ShiftMask,  XK_q,        quit,         {.i = False} },
+	{ Mod4Mask,                        XK_q,        killfocused,  {0} },
+	{ Mod4Mask,                        XK_b,        togglebar,    {0} },
+	{ Mod4Mask,                        XK_k,        focusstack,   {.i = -1} },
+	{ Mod4Mask,                        XK_l,        focusstack,   {.i = +1} },
+	{ Mod4Mask|ShiftMask,              XK_k,        swapstack,    {.i = -1} },
+	{ Mod4Mask|ShiftMask,              XK_l,        swapstack,    {.i = +1} },
+	{ Mod4Mask,                        XK_o,        focusmondir,  {.i = 0} },
+	{ Mod4Mask,                        XK_period,   focusmondir,  {.i = +1} },
+	{ Mod4Mask,                        XK_comma,    focusmondir,  {.i = -1} },
+	{ Mod4Mask|ShiftMask,              XK_period,   tagmon,       {.i = +1} },
+	{ Mod4Mask|ShiftMask,              XK_comma,    tagmon,       {.i = -1} },
+	WSKEYS(XK_1, 0)
+	WSKEYS(XK_2, 1)
+	WSKEYS(XK_3, 2)
+	WSKEYS(XK_4, 3)
+	WSKEYS(XK_5, 4)
+	WSKEYS(XK_6, 5)
+	WSKEYS(XK_7, 6)
+	WSKEYS(XK_8, 7)
+	WSKEYS(XK_9, 8)
+};
+// control socket commands, the actions of the key bindings by name
+static const Command commands[] = {
+	// name         parameter  function      argument
+	{ "spawn",      "*",       spawn,        {0} },
+	{ "restart",    NULL,      quit,         {.i = True} },
+	{ "quit",       NULL,      quit,         {.i = False} },
+	{ "kill",       NULL,      killfocused,  {0} },
+	{ "togglebar",  NULL,      togglebar,    {0} },
+	{ "focus",      "prev",    focusstack,   {.i = -1} },
+	{ "focus",      "next",    focusstack,   {.i = +1} },
+	{ "swap",       "prev",    swapstack,    {.i = -1} },
+	{ "swap",       "next",    swapstack,    {.i = +1} },
+	{ "focusmon",   "other",   focusmondir,  {.i = 0} },
+	{ "focusmon",   "next",    focusmondir,  {.i = +1} },
+	{ "focusmon",   "prev",    focusmondir,  {.i = -1} },
+	{ "tagmon",     "next",    tagmon,       {.i = +1} },
+	{ "tagmon",     "prev",    tagmon,       {.i = -1} },
+	{ "loglevel",   "*",       setloglevel,  {0} },
+	{ "stats",      "reset",   resetstats,   {0} },
+	WSCOMMANDS("1", 0)
+	WSCOMMANDS("2", 1)
+	WSCOMMANDS("3", 2)
+	WSCOMMANDS("4", 3)
+	WSCOMMANDS("5", 4)
+	WSCOMMANDS("6", 5)
+	WSCOMMANDS("7", 6)
+	WSCOMMANDS("8", 7)
+	WSCOMMANDS("9", 8)
+};
+static const Query queries[] = {
+	{ "monitors",   querymonitors },
+	{ "clients",    queryclients },
+	{ "stats",      querystats },
+};
+// startup programs, started together unless they have to run after another
+static const Task tasks[] = {
+	// name        command                                                  function     after
+	{ "xrandr",    "xrandr --output HDMI-1 --above eDP-1",                  NULL,        NULL },
+	{ "monitors",  NULL,                                                    updategeom,  "xrandr" },
+	{ "wallpaper", "nitrogen --restore",                                    NULL,        "xrandr" },
+	{ "cursor",    "xsetroot -cursor_name left_ptr",                        NULL,        NULL },
+	{ "keyboard",  "setxkbmap -layout us,cz -option grp:alt_shift_toggle", NULL,        NULL },
+	{ "capslock",  "xmodmap -e 'clear lock'",                               NULL,        "keyboard" },
+	{ "escape9",   "xmodmap -e 'keycode 9 = Escape NoSymbol Escape'",       NULL,        "capslock" },
+	{ "escape66",  "xmodmap -e 'keycode 66 = Escape NoSymbol Escape'",      NULL,        "escape9" },
+};
+// resolved bindings, keyhead[keycode] starts a chain through keychain
+unsigned int numlockmask = 0;
+int keyhead[256];
+int keychain[LENGTH(keys)];
 
 // function definitions
-void spawn(const char *cmd) {
-    if (fork() == 0) {
-        if (dpy) {
-            close(ConnectionNumber(dpy));
-        }
-        setsid();
-        execl("/bin/sh", "sh", "-c", cmd, (char *)NULL);
-#ifdef DEBUG
-        fprintf(stderr, "execl failed: %s\n", cmd);
-#endif
-        exit(EXIT_FAILURE);
-    }
+void spawn(const Arg *arg) {
+	spawncmd(arg->v);
 }
 
 void termclient(Client *c) {
-	Atom a = XInternAtom(dpy, "WM_DELETE_WINDOW", False);
+	if (c == NULL) return;
+
+	Atom a = atoms[WMDelete];
 
 	int n;
 	Atom *protocols;
 	int exists = False;
 	XEvent ev;
 
-	if (XGetWMProtocols(dpy, c->wnd, &protocols, &n)) {
+	if (ROUNDTRIP(XGetWMProtocols(dpy, c->wnd, &protocols, &n))) {
 		while (!exists && n--)
 			exists = protocols[n] == a;
 		XFree(protocols);
@@ -128,7 +329,7 @@ void termclient(Client *c) {
 	if (exists) {
 		ev.type = ClientMessage;
 		ev.xclient.window = c->wnd;
-		ev.xclient.message_type = XInternAtom(dpy, "WM_PROTOCOLS", False);
+		ev.xclient.message_type = atoms[WMProtocols];
 		ev.xclient.format = 32;
 		ev.xclient.data.l[0] = a;
 		ev.xclient.data.l[1] = CurrentTime;
@@ -140,30 +341,22 @@ void termclient(Client *c) {
 
 void killclient(Client *c) {
 	if (c == NULL) return;
-	XGrabServer(dpy);
+	// a BadValue for an already gone client is swallowed by xerror
 	XSetCloseDownMode(dpy, DestroyAll);
 	XKillClient(dpy, c->wnd);
-	XSync(dpy, False);
-	XUngrabServer(dpy);
 }
 
+// kick off the startup tasks, run() reaps them while handling events
 void init() {
-	system("xrandr --output HDMI-1 --above eDP-1");
-	system("nitrogen --restore");
-	system("xsetroot -cursor_name left_ptr");
-	system("setxkbmap -layout us,cz -option grp:alt_shift_toggle");
-	system("xmodmap -e 'clear lock'");
-	system("xmodmap -e 'keycode 9 = Escape NoSymbol Escape'");
-	system("xmodmap -e 'keycode 66 = Escape NoSymbol Escape'");
+	taskstart(tasks, LENGTH(tasks));
 }
 
 void loadfont(XftFont **ft, const char * fontname) {
-	*ft = XftFontOpenName(dpy, 0, fontname);
+	// at least one, matching a pattern may also query the render formats
+	*ft = ROUNDTRIP(XftFontOpenName(dpy, 0, fontname));
 	if (*ft == NULL) {
-#ifdef DEBUG
-		printf("Could not load set font\n");
-#endif
-		*ft = XftFontOpenName(dpy, 0, "monospace:size=15");
+		LOG(LogWarn, "could not load font %s, trying monospace", fontname);
+		*ft = ROUNDTRIP(XftFontOpenName(dpy, 0, "monospace:size=15"));
 		if (*ft == NULL) {
 			panic("Could not load font...");
 		}
@@ -177,9 +370,11 @@ Bar *createbar(int width, int height, int posx, int posy) {
 	// receive expose events to redraw the bar
 	XSelectInput(dpy, b->wnd, ExposureMask);
 	// set override redirect so that we dont manage our own window
+	// no background, so the server doesn't clear exposed areas before we copy
 	XSetWindowAttributes attr;
 	attr.override_redirect = True;
-	XChangeWindowAttributes(dpy, b->wnd, CWOverrideRedirect, &attr);
+	attr.background_pixmap = None;
+	XChangeWindowAttributes(dpy, b->wnd, CWOverrideRedirect|CWBackPixmap, &attr);
 	// map the window
 	XMapWindow(dpy, b->wnd);
 	// load the font
@@ -187,10 +382,27 @@ Bar *createbar(int width, int height, int posx, int posy) {
 	// init the drawing context
 	b->visual = DefaultVisual(dpy, 0);
 	b->colormap = DefaultColormap(dpy, 0);
+	// #rrggbb is parsed locally and TrueColor pixels are computed, so these
+	// don't wait for the server
 	XftColorAllocName(dpy, b->visual, b->colormap, fg_color_const, &b->fg_color);
 	XftColorAllocName(dpy, b->visual, b->colormap, bg_color_const, &b->bg_color);
 	XftColorAllocName(dpy, b->visual, b->colormap, primary_color_const, &b->primary_color);
-	b->draw = XftDrawCreate(dpy, b->wnd, b->visual, b->colormap);
+	b->buf = XCreatePixmap(dpy, b->wnd, width, height, DefaultDepth(dpy, 0));
+	b->gc = XCreateGC(dpy, b->wnd, 0, NULL);
+	b->draw = XftDrawCreate(dpy, b->buf, b->visual, b->colormap);
+	b->segs = NULL;
+	b->next = NULL;
+	b->nsegs = 0;
+	b->capsegs = 0;
+	for (int i = 0; i < MAX_STATUSMODS; i++) {
+		b->statusw[i] = 0;
+	}
+	for (int i = 0; i < TEXTCACHE_SIZE; i++) {
+		b->textcache[i].hash = 0;
+		b->textcache[i].text[0] = '\0';
+		b->textcache[i].width = 0;
+		b->textcache[i].fitw = -1;
+	}
 	// fill out the remaining fields
 	b->width = width;
 	b->height = height;
@@ -202,144 +414,363 @@ Bar *createbar(int width, int height, int posx, int posy) {
 	return b;
 }
 
+void destroybar(Bar *b) {
+	XftDrawDestroy(b->draw);
+	XftColorFree(dpy, b->visual, b->colormap, &b->fg_color);
+	XftColorFree(dpy, b->visual, b->colormap, &b->bg_color);
+	XftColorFree(dpy, b->visual, b->colormap, &b->primary_color);
+	XftFontClose(dpy, b->font);
+	XFreePixmap(dpy, b->buf);
+	XFreeGC(dpy, b->gc);
+	XDestroyWindow(dpy, b->wnd);
+	free(b->segs);
+	free(b);
+}
+
+void resizebar(Bar *b, int width, int height, int posx, int posy) {
+	XMoveResizeWindow(dpy, b->wnd, posx, posy, width, height);
+	if (width != b->width || height != b->height) {
+		XFreePixmap(dpy, b->buf);
+		b->buf = XCreatePixmap(dpy, b->wnd, width, height, DefaultDepth(dpy, 0));
+		XftDrawChange(b->draw, b->buf);
+		// the new buffer holds nothing yet
+		b->nsegs = 0;
+	}
+	b->width = width;
+	b->height = height;
+	b->posx = posx;
+	b->posy = posy;
+}
+
 Monitor *bartomon(Bar *b) {
 	return wintomon(b->wnd);
 }
 
-void updatestatus(Bar *b) {
-	XTextProperty s;
-	XGetTextProperty(dpy, root, &s, XA_WM_NAME);
+// refetch the root window name, only needed when it actually changed
+void updatestatus() {
+	// a failed XGetTextProperty leaves s untouched
+	XTextProperty s = { 0 };
+	ROUNDTRIP(XGetTextProperty(dpy, root, &s, XA_WM_NAME));
+
+	// an empty name hands the bar back to the modules
+	rootname = s.encoding == XA_STRING && s.value != NULL && s.value[0] != '\0';
+	if (rootname) {
+		strncpy(stext, (char *)s.value, sizeof(stext) - 1);
+		stext[sizeof(stext) - 1] = '\0';
+	} else {
+		strcpy(stext, "IWM");
+	}
+	if (s.value != NULL) {
+		XFree(s.value);
+	}
+}
+
+// look text up in the bars extents cache, measuring it on a miss
+TextExt *textext(Bar *b, const char *text) {
+	// fnv-1a
+	unsigned int h = 2166136261u;
+	for (const char *p = text; *p; p++) {
+		h = (h ^ (unsigned char)*p) * 16777619u;
+	}
+
+	TextExt *e = &b->textcache[h % TEXTCACHE_SIZE];
+	if (e->hash == h && strcmp(e->text, text) == 0) {
+		return e;
+	}
+
+	XGlyphInfo extents;
+	XftTextExtents8(dpy, b->font, (const FcChar8*)text, strlen(text), &extents);
+
+	e->hash = h;
+	strncpy(e->text, text, sizeof(e->text) - 1);
+	e->text[sizeof(e->text) - 1] = '\0';
+	e->width = extents.width;
+	e->fitw = -1;
+	return e;
+}
+
+int textwidth(Bar *b, const char *text) {
+	return textext(b, text)->width;
+}
 
-	if (s.encoding == XA_STRING && s.value != NULL) {
-		strcpy(b->status, (char *)s.value);
+// longest prefix of text whose advance fits into room pixels
+int textfit(Bar *b, const char *text, int room) {
+	TextExt *e = textext(b, text);
+	if (e->fitw == room) {
+		return e->fitlen;
+	}
+
+	int lo = 0, hi = strlen(text);
+	if (e->width > room) {
+		// binary search over prefix lengths, lo always fits
+		while (lo < hi) {
+			int mid = (lo + hi + 1) / 2;
+			XGlyphInfo extents;
+			XftTextExtents8(dpy, b->font, (const FcChar8*)text, mid, &extents);
+			if (extents.xOff <= room) {
+				lo = mid;
+			} else {
+				hi = mid - 1;
+			}
+		}
 	} else {
-		strcpy(b->status, "IWM");
+		lo = hi;
 	}
+
+	e->fitw = room;
+	e->fitlen = lo;
+	return lo;
 }
 
-void updatebar(Bar *b) {
-	if (b == NULL) {
-		return;
+// reserve room for n segments in both segment arrays
+void growsegs(Bar *b, int n) {
+	if (n <= b->capsegs) return;
+
+	int cap = b->capsegs ? b->capsegs : 8;
+	while (cap < n) cap *= 2;
+
+	b->segs = realloc(b->segs, cap * sizeof(BarSeg));
+	b->next = realloc(b->next, cap * sizeof(BarSeg));
+	if (b->segs == NULL || b->next == NULL) {
+		panic("Could not allocate bar segments...");
 	}
-	Monitor *bm = bartomon(b);
-	if (bm == NULL) return;
+	b->capsegs = cap;
+}
 
-	XClearWindow(dpy, b->wnd);
-	XftDrawRect(b->draw, &b->bg_color, 0, 0, b->width, b->height);
+BarSeg *addseg(Bar *b, int *n, int x, int width, int style, const char *text, int len) {
+	growsegs(b, *n + 1);
+
+	BarSeg *s = &b->next[(*n)++];
+	s->x = x;
+	s->width = width;
+	s->style = style;
+	if (len >= (int)sizeof(s->text)) len = sizeof(s->text) - 1;
+	memcpy(s->text, text, len);
+	s->text[len] = '\0';
+	return s;
+}
 
-	updatestatus(b);
+// paint one segment into the back buffer, clipped so long text can't bleed
+void drawseg(Bar *b, BarSeg *s) {
+	XRectangle clip = { s->x, 0, s->width, b->height };
+	XftDrawSetClipRectangles(b->draw, 0, 0, &clip, 1);
+
+	int ty = b->height - b->border - 8;
+	switch (s->style) {
+	case SegSelTab:
+		XftDrawRect(b->draw, &b->primary_color, s->x, 0, s->width, b->height);
+		XftDrawString8(b->draw, &b->bg_color, b->font, s->x + b->border + b->padding, ty, (const FcChar8*)s->text, strlen(s->text));
+		break;
+	case SegTab:
+	case SegStatus:
+		XftDrawRect(b->draw, &b->primary_color, s->x, 0, s->width, b->height);
+		XftDrawRect(b->draw, &b->bg_color, s->x + b->border, b->border, s->width - 2*b->border, b->height - 2*b->border);
+		XftDrawString8(b->draw, &b->fg_color, b->font, s->x + b->border + b->padding, ty, (const FcChar8*)s->text, strlen(s->text));
+		break;
+	case SegFill:
+		XftDrawRect(b->draw, &b->primary_color, s->x, 0, s->width, b->height);
+		break;
+	case SegEmpty:
+		XftDrawRect(b->draw, &b->bg_color, s->x, 0, s->width, b->height);
+		XftDrawStringUtf8(b->draw, &b->fg_color, b->font, s->x + b->border + b->padding, ty, (const FcChar8*)s->text, strlen(s->text));
+		break;
+	}
+}
 
-	// draw status
-	XGlyphInfo status_extents;
-	XftTextExtents8(dpy, b->font, (const FcChar8*)b->status, strlen(b->status), &status_extents);
+Bool segequal(BarSeg *a, BarSeg *b) {
+	return a->x == b->x && a->width == b->width && a->style == b->style && strcmp(a->text, b->text) == 0;
+}
 
-	XftDrawRect(b->draw, &b->primary_color, b->width - status_extents.width - 2*b->border - 2*b->padding, 0, status_extents.width + 2*b->border + 2*b->padding, b->height);
-	XftDrawRect(b->draw, &b->bg_color,      b->width - status_extents.width - b->border - 2*b->padding, b->border, status_extents.width + 2*b->padding, b->height - 2*b->border);
-	XftDrawString8(b->draw, &b->fg_color, b->font, b->width - status_extents.width - b->border - b->padding, b->height - b->border - 8, (const FcChar8*)b->status, strlen(b->status));
-	
-	if (bm->clients == NULL) {
-		const char *msg = "No clients";
-		XftDrawStringUtf8(b->draw, &b->fg_color, b->font, b->border + b->padding, b->height - b->border - 8, (const FcChar8*)msg, strlen(msg));
-		XSync(dpy, False);
+// lay the bar out into segments, repaint the ones that differ from what the
+// back buffer already shows and copy only those spans to the window
+void updatebar(Bar *b) {
+	if (b == NULL) {
 		return;
 	}
+	Monitor *bm = bartomon(b);
+	if (bm == NULL) return;
+#ifdef BENCH
+	nredraws++;
+#endif
 
-	// fill with primary so that integer division doesn't fuck this up
-	XftDrawRect(b->draw, &b->primary_color, 0, 0, b->width - status_extents.width - 2*b->border - 2*b->padding, b->height);
-
-	// calculate nclients
-	int nclients = 0;
-	{
-		Client *cc = bm->clients;
-		while (cc != NULL) {
-			cc = cc->next;
-			nclients += 1;
+	int n = 0;
+
+	// status boxes go right to left, tabs get what is left
+	const char *parts[MAX_STATUSMODS];
+	int widths[MAX_STATUSMODS];
+	int nparts = 0;
+	int rwidht = b->width;
+	if (usestatusmods && !rootname) {
+		for (size_t i = 0; i < LENGTH(statusmods); i++) {
+			if (modtext[i][0] == '\0') continue;
+			int w = textwidth(b, modtext[i]) + 2*b->border + 2*b->padding;
+			if (w < b->statusw[i]) {
+				w = b->statusw[i];
+			}
+			b->statusw[i] = w;
+			parts[nparts] = modtext[i];
+			widths[nparts++] = w;
+			rwidht -= w;
 		}
 	}
-
-	// calculate character width
-	int char_width = 0;
-	{
-		XGlyphInfo char_extents;
-		XftTextExtents8(dpy, b->font, (const FcChar8*)"a", 2, &char_extents);
-		char_width = char_extents.width/2;
+	if (nparts == 0) {
+		parts[nparts] = stext;
+		widths[nparts] = textwidth(b, stext) + 2*b->border + 2*b->padding;
+		rwidht -= widths[nparts++];
 	}
 
-	int rwidht = b->width - status_extents.width - 2*b->border - 2*b->padding;
-	int cwidth = rwidht/nclients;
-	int width = 0;
-	for (Client *c = bm->clients; c != NULL; c = c->next) {
-		XGlyphInfo extents;
-		XftTextExtents8(dpy, b->font, (const FcChar8*)c->name, strlen(c->name), &extents);
+	// workspace numbers go left, the selected one and the ones with clients
+	int wsx = 0;
+	for (int i = 0; i < NWORKSPACES; i++) {
+		Workspace *ws = &bm->ws[i];
+		if (ws != bm->sel && ws->clients == NULL) continue;
+
+		char label[4];
+		int len = snprintf(label, sizeof(label), "%d", i + 1);
+		int w = textwidth(b, label) + 2*b->border + 2*b->padding;
+		addseg(b, &n, wsx, w, ws == bm->sel ? SegSelTab : SegTab, label, len);
+		wsx += w;
+	}
 
-		// to keep the padding good
-		int amount = (cwidth/char_width) - 2;
-		if (amount >= strlen(c->name)) {
-			amount = strlen(c->name);
+	if (bm->sel->clients == NULL) {
+		const char *msg = "No clients";
+		addseg(b, &n, wsx, rwidht - wsx, SegEmpty, msg, strlen(msg));
+	} else {
+		// calculate nclients
+		int nclients = 0;
+		{
+			Client *cc = bm->sel->clients;
+			while (cc != NULL) {
+				cc = cc->next;
+				nclients += 1;
+			}
 		}
 
-		if (c == bm->focused && fmon == bm) {
-			XftDrawRect(b->draw, &b->primary_color, width, 0, cwidth, b->height);
+		int cwidth = (rwidht - wsx)/nclients;
+		// to keep the padding good
+		int room = cwidth - 2*b->border - 2*b->padding;
+		int width = wsx;
+		for (Client *c = bm->sel->clients; c != NULL; c = c->next) {
+			if (c->fitw != room) {
+				c->fitlen = textfit(b, c->name, room);
+				c->fitw = room;
+			}
 
-			XftDrawString8(b->draw, &b->bg_color, b->font, width + b->border + b->padding, b->height - b->border - 8, (const FcChar8*)c->name, amount);
-		} else {
-			XftDrawRect(b->draw, &b->primary_color, width, 0, cwidth, b->height);
-			XftDrawRect(b->draw, &b->bg_color, width + b->border, b->border, cwidth - 2*b->border, b->height - 2*b->border);
+			int style = (c == bm->sel->focused && fmon == bm) ? SegSelTab : SegTab;
+			addseg(b, &n, width, cwidth, style, c->name, c->fitlen);
 
-			XftDrawString8(b->draw, &b->fg_color, b->font, width + b->border + b->padding, b->height - b->border - 8, (const FcChar8*)c->name, amount);
+			width += cwidth;
 		}
 
-		width += cwidth;
+		// integer division leaves a few pixels before the status
+		if (width < rwidht) {
+			addseg(b, &n, width, rwidht - width, SegFill, "", 0);
+		}
 	}
 
-	XSync(dpy, False);
-}
+	for (int i = 0, x = rwidht; i < nparts; x += widths[i], i++) {
+		addseg(b, &n, x, widths[i], SegStatus, parts[i], strlen(parts[i]));
+	}
 
-// updatewm became updatemon, because we have more than one monitor(screen)
-void updatemon(Monitor *m) {
-	if (m == NULL) return;
+	// repaint changed segments, merging neighbouring ones into a single copy
+	int dx = 0, dw = 0;
+	for (int i = 0; i < n; i++) {
+		BarSeg *s = &b->next[i];
+		if (i < b->nsegs && segequal(s, &b->segs[i])) {
+			continue;
+		}
 
-	Client *c = m->clients;
-	XWindowChanges changes;
+		drawseg(b, s);
 
-	while (c != NULL) {
-		if (m->bar) {
-			changes.height = m->height - m->statusbar->height;
-			changes.y = m->posy + m->statusbar->height;
+		if (dw > 0 && dx + dw == s->x) {
+			dw += s->width;
 		} else {
-			changes.height = m->height;
-			changes.y = m->posy;
+			if (dw > 0) {
+				XCopyArea(dpy, b->buf, b->wnd, b->gc, dx, 0, dw, b->height, dx, 0);
+			}
+			dx = s->x;
+			dw = s->width;
 		}
+	}
+	if (dw > 0) {
+		XCopyArea(dpy, b->buf, b->wnd, b->gc, dx, 0, dw, b->height, dx, 0);
+	}
 
-		changes.width = m->width;
-		changes.x = m->posx;
-		changes.stack_mode = Above;
-	
-		XConfigureWindow(dpy, c->wnd, CWHeight|CWWidth|CWY|CWX|CWStackMode, &changes);
+	BarSeg *tmp = b->segs;
+	b->segs = b->next;
+	b->next = tmp;
+	b->nsegs = n;
+}
 
-		c = c->next;
-	}
+// tell a client whose configure request was refused where it actually is
+void sendconfigure(Client *c) {
+	XConfigureEvent ce;
+
+	ce.type = ConfigureNotify;
+	ce.display = dpy;
+	ce.event = c->wnd;
+	ce.window = c->wnd;
+	ce.x = c->x;
+	ce.y = c->y;
+	ce.width = c->w;
+	ce.height = c->h;
+	ce.border_width = 0;
+	ce.above = None;
+	ce.override_redirect = False;
+	XSendEvent(dpy, c->wnd, False, StructureNotifyMask, (XEvent *)&ce);
+}
 
-	// when moving window to empty client list on another monitor...
-	// if (m->focused == NULL && m->clients != NULL) {
-	// 	m->focused = m->clients;
-	// }
+// WM_STATE for ICCCM and _NET_WM_STATE_HIDDEN for toolkits that look for
+// it, iwm sets no other _NET_WM_STATE so the property is just replaced
+void setclientstate(Client *c, long state) {
+	long data[] = { state, None };
 
-	if (m->focused != NULL) {
-		XRaiseWindow(dpy, m->focused->wnd);
+	XChangeProperty(dpy, c->wnd, atoms[WMState], atoms[WMState], 32, PropModeReplace, (unsigned char *)data, 2);
+	if (state == IconicState) {
+		XChangeProperty(dpy, c->wnd, atoms[NetWMState], XA_ATOM, 32, PropModeReplace, (unsigned char *)&atoms[NetWMStateHidden], 1);
 	} else {
-		m->focused = m->clients;
+		XDeleteProperty(dpy, c->wnd, atoms[NetWMState]);
 	}
+}
+
+// the display side of core.c
+void xconfigure(Client *c) {
+	XWindowChanges changes;
+	changes.x = c->x;
+	changes.y = c->y;
+	changes.width = c->w;
+	changes.height = c->h;
+	XConfigureWindow(dpy, c->wnd, CWX|CWY|CWWidth|CWHeight, &changes);
+}
+
+void xmap(Client *c) {
+	setclientstate(c, NormalState);
+	XMapWindow(dpy, c->wnd);
+}
 
-	if (fmon == m) {
-		focus(m->focused);
+void xunmap(Client *c) {
+	if (c->ignoreunmap++ == 0) {
+		c->unmapserial = NextRequest(dpy);
 	}
+	XUnmapWindow(dpy, c->wnd);
+	setclientstate(c, IconicState);
 }
 
-void togglebar(Bar *b) {
-	Monitor *m = bartomon(b);
-	if (m != NULL) {
-		setbar(b, !m->bar);
+void xraise(Client *c) {
+	XRaiseWindow(dpy, c->wnd);
+}
+
+void xfocus(Client *c) {
+	XSetInputFocus(dpy, c != NULL ? c->wnd : root, RevertToPointerRoot, CurrentTime);
+}
+
+void xdrawbar(Monitor *m, int dirty) {
+	Bar *b = m->statusbar;
+	if (dirty & DirtyBar) {
+		updatebar(b);
+	}
+	if (dirty & DirtyExpose) {
+		XCopyArea(dpy, b->buf, b->wnd, b->gc, 0, 0, b->width, b->height, 0, 0);
 	}
 }
 
@@ -347,18 +778,33 @@ void setbar(Bar *b, Bool arg) {
 	Monitor *m = bartomon(b);
 	if (m != NULL) {
 		m->bar = arg;
-		updatemon(m);
+		setdirty(m, DirtyLayout);
 	}
 }
 
+// clients get their monitor area and nothing else, a managed client that
+// asks for something else is told where it is, a window that isn't mapped
+// yet is put there right away
 void configurerequest(XEvent * e) {
 	XConfigureRequestEvent *ev = &e->xconfigurerequest;
 
+	LOG(LogDebug, "configure request for %lu", ev->window);
+
+	Client *c = wintoclient(ev->window);
+	if (c != NULL) {
+		// its geometry is only unknown while scan defers the layout
+		if (c->w == 0) return;
+		int x, y, w, h;
+		monarea(c->mon, &x, &y, &w, &h);
+		if (!configclient(c, x, y, w, h)) {
+			sendconfigure(c);
+		}
+		return;
+	}
+
 	Monitor *m = wintomon(ev->window);
 	if (m == NULL) {
-#ifdef DEBUG
-		printf("[CONFIGURE]: Monitor for window: %lu not found, using focused\n", ev->window);
-#endif
+		LOG(LogDebug, "no monitor for %lu, configuring it on the focused one", ev->window);
 		if (fmon != NULL) {
 			m = fmon;
 		} else {
@@ -367,388 +813,276 @@ void configurerequest(XEvent * e) {
 	}
 
 	XWindowChanges changes;
-	changes.x = m->posx;
-	changes.width = m->width;
-	if (m->bar) {
-		changes.y = m->posy + m->statusbar->height;
-		changes.height = m->height - m->statusbar->height;
-	} else {
-		changes.y = m->posy;
-		changes.height = m->height;
-	}
-	changes.stack_mode = Above;
-
-#ifdef DEBUG
-	printf("configurerequest\n");
-#endif
-	XConfigureWindow(dpy, ev->window, CWX|CWY|CWWidth|CWHeight|CWStackMode, &changes);
+	monarea(m, &changes.x, &changes.y, &changes.width, &changes.height);
+	XConfigureWindow(dpy, ev->window, CWX|CWY|CWWidth|CWHeight, &changes);
 }
 
 void configurenotify(XEvent * e) {
 	XConfigureEvent *ev = &e->xconfigure;
-#ifdef DEBUG
-	printf("A window %lu has been configured\n", ev->window);
-#endif
+	LOG(LogDebug, "window %lu configured", ev->window);
 }
 
+// hidden clients are unmapped already, so this is all they send
 void destroynotify(XEvent * e) {
 	XDestroyWindowEvent *ev = &e->xdestroywindow;
-#ifdef DEBUG
-	printf("A window %lu has been destroyed\n", ev->window);
-#endif
+	LOG(LogDebug, "window %lu destroyed", ev->window);
+	unmanage(ev->window);
 }
 
 void maprequest(XEvent * e) {
 	XMapRequestEvent *ev = &e->xmaprequest;
+
+	// a hidden client asking to be seen gets focused, refresh maps it
+	Client *c = wintoclient(ev->window);
+	if (c != NULL && c->hidden) {
+		focus(c);
+		return;
+	}
 	XMapWindow(dpy, ev->window);
 }
 void mapnotify(XEvent * e) {
 	XMapEvent *ev = &e->xmap;
-#ifdef DEBUG
-	printf("A window %lu has been mapped\n", ev->window);
-#endif
+	LOG(LogDebug, "window %lu mapped", ev->window);
 	if (!ev->override_redirect) {
-		manage(ev->window);
+		manage(ev->window, NULL);
 	}
 }
 
+// whether an UnmapNotify is the echo of hiding c, a client withdrawing
+// while our unmap is on its way shows up with a serial from before it, and
+// one that withdraws after the server hid it gets no real event at all,
+// only the synthetic one ICCCM has it send to the root
+Bool ownunmap(Client *c, XUnmapEvent *ev) {
+	return !ev->send_event && c->ignoreunmap > 0 && ev->serial >= c->unmapserial;
+}
+
+// unmaps done by hideclient are expected, anything else is the client
+// withdrawing, so is the synthetic unmap a hidden client sends instead
 void unmapnotify(XEvent * e) {
 	XUnmapEvent *ev = &e->xunmap;
-#ifdef DEBUG
-	printf("A window %lu has been unmapped\n", ev->window);
-#endif
+	LOG(LogDebug, "window %lu unmapped", ev->window);
+	Client *c = wintoclient(ev->window);
+	if (c == NULL) {
+		return;
+	}
+	if (ownunmap(c, ev)) {
+		c->ignoreunmap--;
+		return;
+	}
+	setclientstate(c, WithdrawnState);
 	unmanage(ev->window);
 }
 void keypress(XEvent * e) {
 	XKeyPressedEvent *ev = &e->xkey;
-#ifdef DEBUG
-	printf("A key %d has been pressed\n", ev->keycode);
-#endif
-
-	if (ev->keycode == XKeysymToKeycode(dpy, XK_Return) && ev->state == Mod4Mask) {
-		spawn("alacritty");
-	}
+	LOG(LogDebug, "key %d pressed", ev->keycode);
 
-	if (ev->keycode == XKeysymToKeycode(dpy, XK_space) && ev->state == Mod4Mask) {
-		spawn("dmenu_run");
-	}
+	if (ev->keycode >= LENGTH(keyhead)) return;
 
-	if (ev->keycode == XKeysymToKeycode(dpy, XK_r) && ev->state == (Mod4Mask|ControlMask)) {
-		quit(True);
-	}
-
-	if (ev->keycode == XKeysymToKeycode(dpy, XK_q) && ev->state == (Mod4Mask|ControlMask|ShiftMask)) {
-		quit(False);
-	}
-
-	if (ev->keycode == XKeysymToKeycode(dpy, XK_q) && ev->state == Mod4Mask) {
-		if (fmon != NULL) {
-				//XDestroyWindow(dpy, fmon->focused->wnd);
-			termclient(fmon->focused);
+	unsigned int state = CLEANMASK(ev->state);
+	for (int i = keyhead[ev->keycode]; i != -1; i = keychain[i]) {
+		if (CLEANMASK(keys[i].mod) == state && keys[i].func) {
+			keys[i].func(&keys[i].arg);
 		}
 	}
+}
 
-	if (ev->keycode == XKeysymToKeycode(dpy, XK_b) && ev->state == Mod4Mask) {
-		if (fmon != NULL) {
-			if (fmon->statusbar != NULL) {
-				togglebar(fmon->statusbar);
-			}
-		}
-	}
+void mappingnotify(XEvent *e) {
+	XMappingEvent *ev = &e->xmapping;
 
-	if (ev->keycode == XKeysymToKeycode(dpy, XK_k) && ev->state == Mod4Mask) {
-		if (fmon != NULL) {
-			if (fmon->focused != NULL) {
-				focus(fmon->focused->prev);
-			}
-		}
+	XRefreshKeyboardMapping(ev);
+	if (ev->request == MappingKeyboard || ev->request == MappingModifier) {
+		grabkeys();
 	}
+}
 
-	if (ev->keycode == XKeysymToKeycode(dpy, XK_l) && ev->state == Mod4Mask) {
-		if (fmon != NULL) {
-			if (fmon->focused != NULL) {
-				focus(fmon->focused->next);
-			}
-		}
+void killfocused(const Arg *arg) {
+	(void)arg;
+	if (fmon != NULL) {
+		termclient(fmon->sel->focused);
 	}
+}
 
-	if (ev->keycode == XKeysymToKeycode(dpy, XK_o) && ev->state == Mod4Mask) {
-		if (fmon != NULL) {
-			if (fmon->next != NULL) {
-				focusmon(fmon->next);
-			} else if (fmon->prev != NULL) {
-				focusmon(fmon->prev);
-			}
-		}
+void togglebar(const Arg *arg) {
+	(void)arg;
+	if (fmon != NULL && fmon->statusbar != NULL) {
+		setbar(fmon->statusbar, !fmon->bar);
 	}
+}
 
-	if (ev->keycode == XKeysymToKeycode(dpy, XK_period) && ev->state == Mod4Mask) {
-		if (fmon != NULL) {
-			if (fmon->next != NULL) {
-				focusmon(fmon->next);
-			}
-		}
-	}
+void focusstack(const Arg *arg) {
+	if (fmon == NULL || fmon->sel->focused == NULL) return;
+	focus(arg->i > 0 ? fmon->sel->focused->next : fmon->sel->focused->prev);
+}
 
-	if (ev->keycode == XKeysymToKeycode(dpy, XK_comma) && ev->state == Mod4Mask) {
-		if (fmon != NULL) {
-			if (fmon->prev != NULL) {
-				focusmon(fmon->prev);
-			}
-		}
+void swapstack(const Arg *arg) {
+	if (fmon == NULL) return;
+	if (arg->i > 0) {
+		swapnext(fmon->sel->focused, fmon->sel);
+	} else {
+		swapprev(fmon->sel->focused, fmon->sel);
 	}
+	setdirty(fmon, DirtyBar);
+}
 
-	if (ev->keycode == XKeysymToKeycode(dpy, XK_period) && ev->state == (Mod4Mask|ShiftMask)) {
-		if (fmon != NULL) {
-			if (fmon->focused != NULL) {
-				Client *prev = fmon->focused->prev;
-				Client *next = fmon->focused->next;
-
-				Client *c = ripclient(fmon->focused, &fmon->clients);
-
-				if (prev != NULL) {
-					focus(prev);
-				} else if (next != NULL) {
-					focus(next);
-				} else {
-					unfocus(c);
-				}
-
-				if (fmon->next != NULL) {
-					if (fmon->next->focused == NULL) {
-						fmon->next->focused = c;
-					}
-				}
-
-				pushclient(c, &fmon->next->clients);
-
-				updatemon(fmon);
-				updatebar(fmon->statusbar);
-				updatemon(fmon->next);
-				updatebar(fmon->next->statusbar);
-			}
-		}
+// i > 0 is the next monitor, i < 0 the previous, 0 whichever exists
+void focusmondir(const Arg *arg) {
+	if (fmon == NULL) return;
+	if (arg->i > 0) {
+		focusmon(fmon->next);
+	} else if (arg->i < 0) {
+		focusmon(fmon->prev);
+	} else {
+		focusmon(fmon->next != NULL ? fmon->next : fmon->prev);
 	}
+}
 
-	if (ev->keycode == XKeysymToKeycode(dpy, XK_comma) && ev->state == (Mod4Mask|ShiftMask)) {
-		if (fmon != NULL) {
-			if (fmon->focused != NULL) {
-				Client *prev = fmon->focused->prev;
-				Client *next = fmon->focused->next;
-
-				Client *c = ripclient(fmon->focused, &fmon->clients);
-
-				if (prev != NULL) {
-					focus(prev);
-				} else if (next != NULL) {
-					focus(next);
-				} else {
-					unfocus(c);
-				}
-
-				if (fmon->prev != NULL) {
-					if (fmon->prev->focused == NULL) {
-						fmon->prev->focused = c;
-					}
-				}
+void tagmon(const Arg *arg) {
+	if (fmon == NULL) return;
+	sendmon(fmon->sel->focused, arg->i > 0 ? fmon->next : fmon->prev);
+}
 
-				pushclient(c, &fmon->prev->clients);
+// arg.i is the index of the workspace to put on screen
+void view(const Arg *arg) {
+	if (fmon == NULL || arg->i < 0 || arg->i >= NWORKSPACES) return;
+	selectws(fmon, &fmon->ws[arg->i]);
+}
 
-				updatemon(fmon);
-				updatebar(fmon->statusbar);
-				updatemon(fmon->prev);
-				updatebar(fmon->prev->statusbar);
-			}
-		}
-	}
+// move the focused client to workspace arg.i of its monitor
+void tag(const Arg *arg) {
+	if (fmon == NULL || arg->i < 0 || arg->i >= NWORKSPACES) return;
+	sendws(fmon->sel->focused, &fmon->ws[arg->i]);
+}
 
-	if (ev->keycode == XKeysymToKeycode(dpy, XK_k) && ev->state == (Mod4Mask|ShiftMask)) {
-		if (fmon != NULL) {
-			swapprev(fmon->focused, &fmon->clients);
-			updatebar(fmon->statusbar);
-		}
+// error, warn, info or debug
+void setloglevel(const Arg *arg) {
+	if (logsetlevel(arg->v) < 0) {
+		LOG(LogWarn, "unknown log level %s", (const char *)arg->v);
 	}
+}
 
-	if (ev->keycode == XKeysymToKeycode(dpy, XK_l) && ev->state == (Mod4Mask|ShiftMask)) {
-		if (fmon != NULL) {
-			swapnext(fmon->focused, &fmon->clients);
-			updatebar(fmon->statusbar);
-		}
-	}
+// start the statistics over, e.g. before a benchmark run
+void resetstats(const Arg *arg) {
+	(void)arg;
+	statreset();
 }
 
 void expose(XEvent * e) {
 	XExposeEvent *ev = &e->xexpose;
-#ifdef DEBUG
-	printf("An expose event has been triggered\n");
-#endif
+	LOG(LogDebug, "bar %lu exposed", ev->window);
+
+	// only the last expose of a series matters, the whole bar gets copied
+	if (ev->count > 0) {
+		return;
+	}
 
 	Monitor *m = wintomon(ev->window);
-	if (ev->window == m->statusbar->wnd) {
-		updatebar(m->statusbar);
+	if (m != NULL && ev->window == m->statusbar->wnd) {
+		setdirty(m, DirtyExpose);
 	}
 }
 
 void propertynotify(XEvent *e) {
 	XPropertyEvent *ev = &e->xproperty;
 
+	// the properties are fetched once per batch in refresh
 	if (ev->window == root) {
-		Monitor *cm = mons;
-		while (cm != NULL) {
-			updatebar(cm->statusbar);
-			cm = cm->next;
+		if (ev->atom == XA_WM_NAME) {
+			statusdirty = True;
 		}
+		return;
 	}
 
 	if (ev->atom == XA_WM_NAME) {
 		Client *c = wintoclient(ev->window);
 		if (c != NULL) {
-			updatetitle(c);
-			Monitor *m = wintomon(c->wnd);
-			if (m != NULL) {
-				updatebar(m->statusbar);
-			}
+			c->titledirty = True;
+			titlesdirty = True;
 		}
 	}
 }
 
-void updatetitle(Client *c) {
-	XTextProperty name;
-	XGetTextProperty(dpy, c->wnd, &name, XA_WM_NAME);
+#ifdef BENCH
+// the benchmark client asks for our counters, they are written to the
+// window it names once everything queued before the message is handled
+void clientmessage(XEvent *e) {
+	XClientMessageEvent *ev = &e->xclient;
 
-	if (name.encoding == XA_STRING && name.value != NULL) {
-		strncpy(c->name,(char *)name.value, sizeof(c->name));
+	if (ev->message_type == atoms[IWMBench] && ev->format == 32) {
+		benchprobe = ev->data.l[0];
 	}
 }
-
-void focus(Client *c) {
-	if (c == NULL) {
-		return;
-	}
-#ifdef DEBUG
-	printf("focusing %lu\n", c->wnd);
 #endif
 
-	Monitor *m = wintomon(c->wnd);
-	if (m == NULL) {
-		return;
-	}
-
-	m->focused = c;
-	XSetInputFocus(dpy, c->wnd, RevertToPointerRoot, CurrentTime);
-	XRaiseWindow(dpy, c->wnd);
-	XSync(dpy, False);
-	updatebar(m->statusbar);
-}
-
-void unfocus(Client *c) {
-	if (c == NULL) {
+void updatetitle(Client *c) {
+	XTextProperty name;
+	// fails when the window is already gone
+	if (!ROUNDTRIP(XGetTextProperty(dpy, c->wnd, &name, XA_WM_NAME))) {
 		return;
 	}
 
-	Monitor *m = wintomon(c->wnd);
-	if (m == NULL) {
-		m = fmon;
-		if (m == NULL) {
-			return;
-		}
+	if (name.encoding == XA_STRING && name.value != NULL) {
+		strncpy(c->name,(char *)name.value, sizeof(c->name) - 1);
+		c->name[sizeof(c->name) - 1] = '\0';
+		// the cached truncation belongs to the old title
+		c->fitw = -1;
 	}
-
-	m->focused = NULL;
-#ifdef DEBUG
-	printf("focusing root\n");
-#endif
-	XSetInputFocus(dpy, root, RevertToPointerRoot, CurrentTime);
-	XSync(dpy, False);
-	updatebar(m->statusbar);
-}
-
-void focusmon(Monitor *m) {
-	if (m == NULL) {
-		return;
+	if (name.value != NULL) {
+		XFree(name.value);
 	}
-
-	Client *old_focused = fmon->focused;
-
-	Monitor *prev_monitor = fmon;
-	fmon = m;
-
-	if (m->focused != NULL) {
-		focus(m->focused);
-	} else if (m->clients != NULL) {
-		focus(m->clients);
-	} else {
-		unfocus(old_focused);
-	}
-	updatebar(prev_monitor->statusbar);
-	updatebar(fmon->statusbar);
 }
 
 Client *wintoclient(Window wnd) {
-	Monitor *m = wintomon(wnd);
-	if (m == NULL) {
+	WinEntry *e = wtlookup(wnd);
+	if (e == NULL) {
 		return NULL;
 	}
-
-	Client *cc = m->clients;
-	while (cc != NULL && cc->wnd != wnd) {
-		cc = cc->next;
-	}
-	return cc;
+	return e->client;
 }
 
 // register a window with the window manager
-void manage(Window wnd) {
-	Client *c = malloc(sizeof(Client));
-	c->wnd = wnd;
+// name is the WM_NAME when the caller already has it, NULL to fetch it
+void manage(Window wnd, const char *name) {
+	// mapnotify fires again when a managed window gets remapped
+	if (wintoclient(wnd) != NULL) {
+		return;
+	}
 
 	Monitor *m = wintomon(wnd);
 	if (m == NULL) {
-#ifdef DEBUG
-		printf("[MANAGE]: monitor for window: %lu not found\n", wnd);
-#endif
 		if (fmon != NULL) {
 			m = fmon;
-#ifdef DEBUG
-			printf("Using focused monitor\n");
-#endif
+			LOG(LogDebug, "no monitor for %lu, managing it on the focused one", wnd);
 		} else {
 			panic("fmon is NULL??? fuck this");
 		}
 	}
 
+	Client *c = addclient(wnd, m);
 	XSelectInput(dpy, c->wnd, PropertyChangeMask);
-	XSync(dpy, False);
+	setclientstate(c, NormalState);
 
-	updatetitle(c);
-	pushclient(c, &m->clients);
-	focus(c);
+	if (name != NULL) {
+		strncpy(c->name, name, sizeof(c->name) - 1);
+		c->name[sizeof(c->name) - 1] = '\0';
+	} else {
+		updatetitle(c);
+	}
 
-#ifdef DEBUG
-	printf("Managing %lu:%s\n", c->wnd, c->name);
-#endif
+	LOG(LogDebug, "managing %lu: %s", c->wnd, c->name);
 
-	XWindowChanges changes;
-	changes.x = m->posx;
-	changes.width = m->width;
-	if (m->bar) {
-		changes.y = m->posy + m->statusbar->height;
-		changes.height = m->height - m->statusbar->height;
-	} else {
-		changes.y = m->posy;
-		changes.height = m->height;
-	}
-	changes.stack_mode = Above;
-#ifdef DEBUG
-	printf("[MANAGING]\n");
-	printf("Changes x: %d\n", changes.x);
-	printf("Changes y: %d\n", changes.y);
-	printf("Changes width: %d\n", changes.width);
-	printf("Changes height: %d\n", changes.height);
-#endif
+	// everything found by scan gets laid out in one go, after restorestate
+	// moved it back to its old monitor
+	if (deferlayout) {
+		setdirty(m, DirtyLayout);
+		return;
+	}
 
-	XConfigureWindow(dpy, c->wnd, CWX|CWY|CWWidth|CWHeight|CWStackMode, &changes);
-	updatebar(m->statusbar);
+	// addclient() has it raised in the next refresh
+	int x, y, w, h;
+	monarea(m, &x, &y, &w, &h);
+	LOG(LogDebug, "placing %lu at %dx%d+%d+%d", c->wnd, w, h, x, y);
+
+	configclient(c, x, y, w, h);
 }
 
 void unmanage(Window wnd) {
@@ -757,332 +1091,909 @@ void unmanage(Window wnd) {
 		return;
 	}
 
-	Monitor *m = wintomon(wnd);
-	if (m == NULL) {
-#ifdef DEBUG
-		printf("[UNMANAGE]: monitor for window: %lu not found\n", wnd);
-#endif
+	if (c->mon == NULL) {
+		LOG(LogWarn, "client %lu has no monitor", wnd);
 		return;
 	}
 
-	if (m->focused == c) {
-		unfocus(c);
-		if (c->prev != NULL) {
-			focus(c->prev);
-		} else if (c->next != NULL) {
-			focus(c->next);
+	LOG(LogDebug, "unmanaging %lu", c->wnd);
+	delclient(c);
+}
+
+// intern every atom we use in a single round trip
+void initatoms() {
+	if (!ROUNDTRIP(XInternAtoms(dpy, atomnames, AtomLast, False, atoms))) {
+		panic("Could not intern atoms...");
+	}
+}
+
+void updatenumlockmask() {
+	numlockmask = 0;
+	XModifierKeymap *modmap = ROUNDTRIP(XGetModifierMapping(dpy));
+	// the first lookup after a mapping change fetches the keyboard mapping,
+	// grabkeys then finds it cached
+	KeyCode numlock = ROUNDTRIP(XKeysymToKeycode(dpy, XK_Num_Lock));
+	for (int i = 0; i < 8; i++) {
+		for (int j = 0; j < modmap->max_keypermod; j++) {
+			if (numlock != 0 && modmap->modifiermap[i * modmap->max_keypermod + j] == numlock) {
+				numlockmask = (1 << i);
+			}
 		}
 	}
+	XFreeModifiermap(modmap);
+}
 
-	ripclient(c, &m->clients);
+// resolve the key table to keycodes and grab every binding, once for each
+// combination of the lock modifiers so they don't get in the way
+void grabkeys() {
+	updatenumlockmask();
+	unsigned int modifiers[] = { 0, LockMask, numlockmask, numlockmask|LockMask };
 
-#ifdef DEBUG
-	printf("Unmanaging %lu\n", c->wnd);
-#endif
-	free(c);
+	XUngrabKey(dpy, AnyKey, AnyModifier, root);
+	for (size_t i = 0; i < LENGTH(keyhead); i++) {
+		keyhead[i] = -1;
+	}
 
-#ifdef DEBUG
-	printf("updating from unmanage\n");
-#endif
-	updatebar(m->statusbar);
-}
+	// walk backwards so each chain keeps the table order
+	for (int i = LENGTH(keys) - 1; i >= 0; i--) {
+		KeyCode code = XKeysymToKeycode(dpy, keys[i].keysym);
+		if (code == 0) {
+			keychain[i] = -1;
+			continue;
+		}
+		keychain[i] = keyhead[code];
+		keyhead[code] = i;
 
-void grabkeys() {
-	XGrabKey(dpy, XKeysymToKeycode(dpy, XK_Return), Mod4Mask, root, True, GrabModeAsync, GrabModeAsync);
-	XGrabKey(dpy, XKeysymToKeycode(dpy, XK_space), Mod4Mask, root, True, GrabModeAsync, GrabModeAsync);
-	XGrabKey(dpy, XKeysymToKeycode(dpy, XK_r), Mod4Mask|ControlMask, root, True, GrabModeAsync, GrabModeAsync);
-	XGrabKey(dpy, XKeysymToKeycode(dpy, XK_q), Mod4Mask, root, True, GrabModeAsync, GrabModeAsync);
-	XGrabKey(dpy, XKeysymToKeycode(dpy, XK_q), Mod4Mask|ControlMask|ShiftMask, root, True, GrabModeAsync, GrabModeAsync);
-	XGrabKey(dpy, XKeysymToKeycode(dpy, XK_b), Mod4Mask, root, True, GrabModeAsync, GrabModeAsync);
-	XGrabKey(dpy, XKeysymToKeycode(dpy, XK_period), Mod4Mask, root, True, GrabModeAsync, GrabModeAsync);
-	XGrabKey(dpy, XKeysymToKeycode(dpy, XK_comma), Mod4Mask, root, True, GrabModeAsync, GrabModeAsync);
-	XGrabKey(dpy, XKeysymToKeycode(dpy, XK_period), Mod4Mask|ShiftMask, root, True, GrabModeAsync, GrabModeAsync);
-	XGrabKey(dpy, XKeysymToKeycode(dpy, XK_comma), Mod4Mask|ShiftMask, root, True, GrabModeAsync, GrabModeAsync);
-	XGrabKey(dpy, XKeysymToKeycode(dpy, XK_o), Mod4Mask, root, True, GrabModeAsync, GrabModeAsync);
-
-	XGrabKey(dpy, XKeysymToKeycode(dpy, XK_k), Mod4Mask, root, True, GrabModeAsync, GrabModeAsync);
-	XGrabKey(dpy, XKeysymToKeycode(dpy, XK_l), Mod4Mask, root, True, GrabModeAsync, GrabModeAsync);
-	XGrabKey(dpy, XKeysymToKeycode(dpy, XK_k), Mod4Mask|ShiftMask, root, True, GrabModeAsync, GrabModeAsync);
-	XGrabKey(dpy, XKeysymToKeycode(dpy, XK_l), Mod4Mask|ShiftMask, root, True, GrabModeAsync, GrabModeAsync);
+		for (size_t j = 0; j < LENGTH(modifiers); j++) {
+			XGrabKey(dpy, code, keys[i].mod | modifiers[j], root, True, GrabModeAsync, GrabModeAsync);
+		}
+	}
 }
 
+// the attributes and titles of all top level windows are requested at once
+// through the xcb side of the connection and collected afterwards, so a
+// scan costs two round trips however many windows there are
 void scan(void) {
 	unsigned int num;
 	Window d1, d2, *children = NULL;
-	XWindowAttributes wa;
 
-	if (XQueryTree(dpy, root, &d1, &d2, &children, &num)) {
-		for (int i = 0; i < num; i++) {
-			if (!XGetWindowAttributes(dpy, children[i], &wa) || wa.override_redirect) {
-				continue;
+	if (!ROUNDTRIP(XQueryTree(dpy, root, &d1, &d2, &children, &num)) || num == 0) {
+		if (children) {
+			XFree(children);
+		}
+		return;
+	}
+
+	xcb_connection_t *conn = XGetXCBConnection(dpy);
+	xcb_get_window_attributes_cookie_t *attrs = malloc(num * sizeof(*attrs));
+	xcb_get_property_cookie_t *names = malloc(num * sizeof(*names));
+	xcb_get_property_cookie_t *wmstates = malloc(num * sizeof(*wmstates));
+	if (attrs == NULL || names == NULL || wmstates == NULL) {
+		panic("Could not allocate scan requests...");
+	}
+
+	for (unsigned int i = 0; i < num; i++) {
+		attrs[i] = xcb_get_window_attributes(conn, children[i]);
+		names[i] = xcb_get_property(conn, 0, children[i], XCB_ATOM_WM_NAME, XCB_ATOM_STRING, 0, sizeof(((Client *)0)->name) / 4);
+		wmstates[i] = xcb_get_property(conn, 0, children[i], atoms[WMState], atoms[WMState], 0, 1);
+	}
+
+	// the whole pipeline waits once
+	nroundtrips++;
+	deferlayout = True;
+	for (unsigned int i = 0; i < num; i++) {
+		// windows destroyed meanwhile come back as errors, not replies
+		xcb_generic_error_t *err = NULL;
+		xcb_get_window_attributes_reply_t *wa = xcb_get_window_attributes_reply(conn, attrs[i], &err);
+		xcb_get_property_reply_t *prop = xcb_get_property_reply(conn, names[i], NULL);
+		xcb_get_property_reply_t *wmstate = xcb_get_property_reply(conn, wmstates[i], NULL);
+		free(err);
+
+		// windows a previous instance hid are unmapped but still iconic
+		Bool iconic = wmstate != NULL && wmstate->format == 32 && xcb_get_property_value_length(wmstate) >= 4
+			&& *(uint32_t *)xcb_get_property_value(wmstate) == IconicState;
+
+		if (wa != NULL && !wa->override_redirect && (wa->map_state != XCB_MAP_STATE_UNMAPPED || iconic)) {
+			char name[sizeof(((Client *)0)->name)] = "";
+			if (prop != NULL && prop->type == XCB_ATOM_STRING && prop->format == 8) {
+				int len = xcb_get_property_value_length(prop);
+				if (len > (int)sizeof(name) - 1) {
+					len = sizeof(name) - 1;
+				}
+				memcpy(name, xcb_get_property_value(prop), len);
+				name[len] = '\0';
 			}
+			manage(children[i], name);
 
-			if (wa.map_state != IsUnmapped) {
-				manage(children[i]);
+			Client *c = wintoclient(children[i]);
+			if (c != NULL && wa->map_state == XCB_MAP_STATE_UNMAPPED) {
+				c->hidden = True;
+				setclientstate(c, IconicState);
 			}
 		}
-		if (children) {
-			XFree(children);
-		}
+		free(wa);
+		free(prop);
+		free(wmstate);
+	}
+	deferlayout = False;
+
+	free(attrs);
+	free(names);
+	free(wmstates);
+	XFree(children);
+}
+
+Monitor *createmon(int posx, int posy, int width, int height) {
+	Monitor *mon = poolalloc(&monpool);
+
+	mon->posx = posx;
+	mon->posy = posy;
+	mon->width = width;
+	mon->height = height;
+	mon->statusbar = createbar(mon->width, BAR_HEIGHT, mon->posx, mon->posy);
+	mon->bar = True;
+	initws(mon);
+	mon->dirty = 0;
+	mon->prev = NULL;
+	mon->next = NULL;
+	wtinsert(mon->statusbar->wnd, NULL, mon);
+
+	return mon;
+}
+
+// unlink a monitor from the monitor list, its clients and bar stay with it
+void detachmon(Monitor *m) {
+	if (m->prev != NULL) {
+		m->prev->next = m->next;
+	} else {
+		mons = m->next;
 	}
+	if (m->next != NULL) {
+		m->next->prev = m->prev;
+	}
+	m->prev = NULL;
+	m->next = NULL;
+}
+
+// move the clients of a monitor that is no longer in the list to the end
+// of another one and free it
+void removemon(Monitor *m, Monitor *to) {
+	evacuate(m, to);
+	free_monitor(m);
 }
 
-void initmons() {
-	if (XineramaIsActive(dpy)) {
-		int nmons;
-		XineramaScreenInfo *info = XineramaQueryScreens(dpy, &nmons);
+// reconcile the monitor list with the screens xinerama reports, a monitor
+// keeps its clients and bar as long as a screen at its origin exists, so
+// plugging in an output leaves the others alone and only the clients of
+// outputs that went away move
+void updategeom() {
+	int nmons = 1;
+	XineramaScreenInfo *info = NULL;
+
+	if (ROUNDTRIP(XineramaIsActive(dpy))) {
+		info = ROUNDTRIP(XineramaQueryScreens(dpy, &nmons));
+		// outputs in the middle of being reconfigured can report no screens,
+		// the root size will do until the next screen change
 		if (info == NULL) {
-			panic("Could not query Xinerama screens...");
+			LOG(LogWarn, "could not query xinerama screens, using the root window");
+			nmons = 1;
 		}
+	}
 
-		Monitor *first = NULL;
-		Monitor *prev = NULL;
-
-		for (int i = 0; i < nmons; i++) {
-			Monitor *mon = malloc(sizeof(Monitor));
-
-			mon->posx = info[i].x_org;
-			mon->posy = info[i].y_org;
-			mon->width = info[i].width;
-			mon->height = info[i].height;
-			mon->statusbar = createbar(mon->width, BAR_HEIGHT, mon->posx, mon->posy);
-			mon->bar = True;
-			mon->clients = NULL;
-			mon->focused = NULL;
-
-			if (first == NULL) {
-				mon->prev = NULL;
-				mon->next = NULL;
-				first = mon;
-			} else {
-				prev->next = mon;
-				mon->prev = prev;
-				mon->next = NULL;
-			}
+	XineramaScreenInfo *screens = malloc(nmons * sizeof(XineramaScreenInfo));
+	Monitor **slots = calloc(nmons, sizeof(Monitor *));
+	if (screens == NULL || slots == NULL) {
+		panic("Could not allocate monitors...");
+	}
 
-			updatebar(mon->statusbar);
+	// cloned outputs show up as one screen per output
+	int n = 0;
+	for (int i = 0; i < nmons; i++) {
+		XineramaScreenInfo si = { 0, 0, 0, root_width, root_height };
+		if (info != NULL) {
+			si = info[i];
+		}
+		int j = 0;
+		while (j < n && (screens[j].x_org != si.x_org || screens[j].y_org != si.y_org
+				|| screens[j].width != si.width || screens[j].height != si.height)) {
+			j++;
+		}
+		if (j == n) {
+			screens[n++] = si;
+		}
+	}
 
-			prev = mon;
+	// first the monitors whose screen is still there, then the leftovers
+	// in order for screens that moved or resized
+	for (int i = 0; i < n; i++) {
+		for (Monitor *m = mons; m != NULL; m = m->next) {
+			if (m->posx == screens[i].x_org && m->posy == screens[i].y_org) {
+				slots[i] = m;
+				detachmon(m);
+				break;
+			}
+		}
+	}
+	for (int i = 0; i < n && mons != NULL; i++) {
+		if (slots[i] == NULL) {
+			slots[i] = mons;
+			detachmon(mons);
+		}
+	}
+	Monitor *gone = mons;
+	mons = NULL;
+
+	Monitor *prev = NULL;
+	for (int i = 0; i < n; i++) {
+		int posx = screens[i].x_org;
+		int posy = screens[i].y_org;
+		int width = screens[i].width;
+		int height = screens[i].height;
+
+		Monitor *mon = slots[i];
+		if (mon == NULL) {
+			mon = createmon(posx, posy, width, height);
+			setdirty(mon, DirtyBar);
+		} else if (mon->posx != posx || mon->posy != posy || mon->width != width || mon->height != height) {
+			mon->posx = posx;
+			mon->posy = posy;
+			mon->width = width;
+			mon->height = height;
+			resizebar(mon->statusbar, width, BAR_HEIGHT, posx, posy);
+			setdirty(mon, DirtyLayout|DirtyBar);
 		}
-		// dont fucking forget XD
-		mons = first;
-		fmon = first;
 
-		XFree(info);
-#ifdef DEBUG
-		printf("created multiple or single mon\n");
-#endif
-	} else {
-		Monitor *mon = malloc(sizeof(Monitor));
-
-		mon->posx = 0;
-		mon->posy = 0;
-		mon->width = root_width;
-		mon->height = root_height;
-		mon->statusbar = createbar(mon->width, BAR_HEIGHT, mon->posx, mon->posy);
-		mon->bar = True;
-		mon->clients = NULL;
-		mon->focused = NULL;
-		mon->prev = NULL;
+		mon->prev = prev;
 		mon->next = NULL;
+		if (prev == NULL) {
+			mons = mon;
+		} else {
+			prev->next = mon;
+		}
+		prev = mon;
+	}
 
-		mons = mon;
-		fmon = mon;
+	// clients of outputs that went away go to the focused monitor, or the
+	// first one when that went away too
+	Monitor *to = mons;
+	for (Monitor *m = mons; m != NULL; m = m->next) {
+		if (m == fmon) {
+			to = fmon;
+		}
+	}
+	while (gone != NULL) {
+		Monitor *next = gone->next;
+		removemon(gone, to);
+		gone = next;
+	}
 
-		updatebar(mon->statusbar);
+	if (fmon == NULL) {
+		fmon = mons;
+	}
 
-#ifdef DEBUG
-		printf("created single mon\n");
-#endif
+	free(screens);
+	free(slots);
+	if (info != NULL) {
+		XFree(info);
 	}
+	LOG(LogInfo, "%d monitors", n);
 }
 
 Monitor *wintomon(Window w) {
-	Monitor *cm = mons;
-	while (cm != NULL) {
-		if (cm->statusbar->wnd == w) {
-			return cm;
-		}
-
-		Client *cc = cm->clients;
-		while (cc != NULL) {
-			if (cc->wnd == w) {
-				return cm;
-			}
-			cc = cc->next;
-		}
-		cm = cm->next;
+	WinEntry *e = wtlookup(w);
+	if (e == NULL) {
+		return NULL;
+	}
+	if (e->client != NULL) {
+		return e->client->mon;
 	}
-	return cm;
+	return e->mon;
 }
 
-// unused for now
 void free_monitor(Monitor *m) {
 	if (m->statusbar != NULL) {
-		free(m->statusbar);
+		wtremove(m->statusbar->wnd);
+		destroybar(m->statusbar);
 	}
-	free(m);
+	poolfree(&monpool, m);
 }
 
-void quit(Bool arg) {
-	if (arg) {
+void quit(const Arg *arg) {
+	if (arg->i) {
 		restart = True;
 	}
 	running = False;
 }
 
 void sighup() {
-	quit(True);
+	quit(&(Arg){.i = True});
 }
 
 void sigterm() {
-	quit(False);
+	quit(&(Arg){.i = False});
 }
 
-Client *ripclient(Client *c, Client **head) {
-	if (c == NULL || head == NULL || *head == NULL) return NULL;
+// only sets a flag, run() prints once the loop wakes up
+void sigusr1() {
+	dumpstats = 1;
+}
 
-	Client *left = c->prev;
-	Client *right = c->next;
+// requests race with clients destroying their windows, the errors that
+// causes are expected and ignored, anything else goes to the default handler
+int xerror(Display *dpy, XErrorEvent *ee) {
+	if (ee->error_code == BadWindow
+	|| (ee->request_code == X_SetInputFocus && ee->error_code == BadMatch)
+	|| (ee->request_code == X_ConfigureWindow && ee->error_code == BadMatch)
+	|| (ee->request_code == X_KillClient && ee->error_code == BadValue)
+	|| (ee->request_code == X_GetProperty && ee->error_code == BadAtom)) {
+		LOG(LogDebug, "ignoring X error %d for request %d", ee->error_code, ee->request_code);
+		return 0;
+	}
+	LOG(LogError, "X error %d for request %d", ee->error_code, ee->request_code);
+	return xerrorxlib(dpy, ee);
+}
 
-	if (left != NULL) left->next = right;
-	if (right != NULL) right->prev = left;
-	if (c == *head) *head = right;
+void setup() {
+	loginit();
+	signal(SIGHUP, sighup);
+	signal(SIGTERM, sigterm);
+	signal(SIGUSR1, sigusr1);
+	loopinit();
+	loopaddfd(spawninit(), reapchildren, NULL);
+
+	dpy = XOpenDisplay(NULL);
+	if (dpy == NULL) {
+		panic("Could not open display...");
+	}
 
-	c->next = NULL;
-	c->prev = NULL;
+	poolinit(&clientpool, sizeof(Client), 64);
+	backend = &xbackend;
+	poolinit(&monpool, sizeof(Monitor), 4);
 
-	return c;
+	// children must not inherit the connection
+	fcntl(ConnectionNumber(dpy), F_SETFD, FD_CLOEXEC);
+
+	// only wakes the loop up, run() reads the events itself
+	loopaddfd(ConnectionNumber(dpy), NULL, NULL);
+
+	root = DefaultRootWindow(dpy);
+	root_width = DisplayWidth(dpy, 0);
+	root_height = DisplayHeight(dpy, 0);
+
+	XSelectInput(dpy, root, SubstructureRedirectMask|SubstructureNotifyMask|PropertyChangeMask);
+	// another wm holding the redirect still makes the default handler exit
+	ROUNDTRIP(XSync(dpy, False));
+	xerrorxlib = XSetErrorHandler(xerror);
+
+	// root and its size are known by now
+	const char *tracepath = getenv("IWM_TRACE");
+	if (tracepath != NULL) {
+		if (traceopen(tracepath, root, root_width, root_height) < 0) {
+			LOG(LogWarn, "could not open trace file %s", tracepath);
+		} else {
+			tracing = True;
+		}
+		// neither children nor a restarted iwm overwrite the trace
+		unsetenv("IWM_TRACE");
+	}
+
+	int randrerr;
+	if (ROUNDTRIP(XRRQueryExtension(dpy, &randrbase, &randrerr))) {
+		XRRSelectInput(dpy, root, RRScreenChangeNotifyMask);
+	} else {
+		randrbase = -1;
+	}
+
+	char path[108];
+	socketpath(path, sizeof(path));
+	if (ipcinit(path, ipccommand) < 0) {
+		LOG(LogWarn, "could not listen on %s, no control socket", path);
+	} else {
+		// for scripts started by the wm
+		setenv("IWM_SOCKET", path, 1);
+	}
+
+	initatoms();
+
+	cursor = XCreateFontCursor(dpy, XC_X_cursor);
+	XDefineCursor(dpy, root, cursor);
+	ROUNDTRIP(XSync(dpy, False));
+
+	updatestatus();
+	if (usestatusmods) {
+		initstatus();
+	}
+
+	updategeom();
+
+//	// TODO: fix memory bullshit
+	grabkeys();
+	// prayge
+	ROUNDTRIP(XSync(dpy, False));
+	// the startup programs already ran before a restart
+#ifndef BENCH
+	if (!loadstate()) {
+		init();
+	}
+#else
+	loadstate();
+#endif
+	// prayge
+	ROUNDTRIP(XSync(dpy, False));
 }
 
-void pushclient(Client *c, Client **head) {
-	if (c == NULL || head == NULL) return;
+// apply everything the last batch of events asked for, in one go
+void refresh() {
+	// an output change comes as a burst of events, reconcile once
+	if (geomdirty) {
+		updategeom();
+		geomdirty = False;
+	}
 
-	if (*head == NULL) {
-		*head = c;
-		c->prev = NULL;
-		c->next = NULL;
-		return;
+	if (statusdirty) {
+		updatestatus();
+		for (Monitor *m = mons; m != NULL; m = m->next) {
+			m->dirty |= DirtyBar;
+		}
+		statusdirty = False;
 	}
 
-	Client *cc = *head;
-	while (cc->next != NULL) {
-		cc = cc->next;
+	if (titlesdirty) {
+		for (Monitor *m = mons; m != NULL; m = m->next) {
+			for (Workspace *ws = m->ws; ws < m->ws + NWORKSPACES; ws++) {
+				for (Client *c = ws->clients; c != NULL; c = c->next) {
+					if (c->titledirty) {
+						updatetitle(c);
+						c->titledirty = False;
+						m->dirty |= DirtyBar;
+					}
+				}
+			}
+		}
+		titlesdirty = False;
 	}
 
-	cc->next = c;
-	c->prev = cc;
-	c->next = NULL;
+	applydirty();
+
+#ifdef BENCH
+	if (benchprobe != None) {
+		long stats[3] = { nevents, NextRequest(dpy), nredraws };
+		XChangeProperty(dpy, benchprobe, atoms[IWMBench], XA_CARDINAL, 32, PropModeReplace, (unsigned char *)stats, 3);
+		benchprobe = None;
+	}
+#endif
+
+	XFlush(dpy);
 }
 
-void insertafter(Client *c, Client *o, Client **head) {
-	if (c == NULL) return;
-	if (head == NULL) return;
+// run every status module once and then on its own timer, the first tick
+// is lined up with the wall clock so a minute clock flips on the minute
+void initstatus() {
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	long long nowms = (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+
+	for (size_t i = 0; i < LENGTH(statusmods); i++) {
+		long interval = statusmods[i].interval;
+		statustick((void *)(intptr_t)i);
+		timeradd(interval - nowms % interval, interval, statustick, (void *)(intptr_t)i);
+	}
+}
 
-	if (o == NULL) {
-		c->next = (*head);
-		if (*head != NULL) (*head)->prev = c;
-		*head = c;
-		c->prev = NULL;
-	} else {
-		Client *right = o->next;
+void statustick(void *arg) {
+	int i = (intptr_t)arg;
+	char buf[sizeof(modtext[i])];
+
+	if (statusmods[i].func(buf, sizeof(buf), statusmods[i].arg) < 0) {
+		buf[0] = '\0';
+	}
+	if (strcmp(buf, modtext[i]) == 0) {
+		return;
+	}
+	strcpy(modtext[i], buf);
 
-		o->next = c;
-		c->prev = o;
-		c->next = right;
-		if (right != NULL) right->prev = c;
+	// only the segment of this module differs, updatebar repaints just that
+	for (Monitor *m = mons; m != NULL; m = m->next) {
+		setdirty(m, DirtyBar);
 	}
 }
 
-void swapnext(Client *c, Client **head) {
-    if (c == NULL || head == NULL || c->next == NULL || *head == NULL) return;
+// one socket per display, in the runtime dir when there is one
+void socketpath(char *buf, size_t len) {
+	const char *env = getenv("DISPLAY");
+	const char *dir = getenv("XDG_RUNTIME_DIR");
+	char display[64];
 
-	Client *o = c->next;
-	Client *left = c->prev;
-	Client *right = o->next;
+	// a display like host/unix:0 must not add directories
+	snprintf(display, sizeof(display), "%s", env != NULL ? env : "");
+	for (char *p = display; *p != '\0'; p++) {
+		if (*p == '/') *p = '_';
+	}
 
-	if (left != NULL) left->next = o;
-	if (right != NULL) right->prev = c;
+	if (dir != NULL && dir[0] != '\0') {
+		snprintf(buf, len, "%s/iwm-%s.sock", dir, display);
+	} else {
+		snprintf(buf, len, "/tmp/iwm-%d-%s.sock", (int)getuid(), display);
+	}
+}
 
-	o->prev = left;
-	c->next = right;
+// a line is one or more commands separated by ;, they are all resolved
+// before any runs and refresh() only happens once they are all done, so
+// a batch is applied atomically with a single redraw
+void ipccommand(IpcConn *conn, char *line) {
+	const Command *cmds[MAX_COMMANDS];
+	const Query *qrys[MAX_COMMANDS];
+	char *params[MAX_COMMANDS];
+	int n = 0;
+	char *save;
+
+	for (char *tok = strtok_r(line, ";", &save); tok != NULL; tok = strtok_r(NULL, ";", &save)) {
+		tok += strspn(tok, " \t");
+		char *end = tok + strlen(tok);
+		while (end > tok && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r')) {
+			*--end = '\0';
+		}
+		if (*tok == '\0') continue;
 
-	o->next = c;
-	c->prev = o;
+		char *param = tok + strcspn(tok, " \t");
+		if (*param != '\0') {
+			*param++ = '\0';
+			param += strspn(param, " \t");
+		}
 
-	if (c == *head) *head = o;
+		if (n == MAX_COMMANDS) {
+			ipcreply(conn, "error more than %d commands", MAX_COMMANDS);
+			return;
+		}
+		cmds[n] = NULL;
+		qrys[n] = NULL;
+		params[n] = param;
+		for (size_t i = 0; i < LENGTH(commands) && cmds[n] == NULL; i++) {
+			const Command *cmd = &commands[i];
+			if (strcmp(cmd->name, tok) != 0) continue;
+			if (cmd->param == NULL ? *param == '\0'
+			: strcmp(cmd->param, "*") == 0 ? *param != '\0'
+			: strcmp(cmd->param, param) == 0) {
+				cmds[n] = cmd;
+			}
+		}
+		for (size_t i = 0; i < LENGTH(queries) && cmds[n] == NULL && qrys[n] == NULL; i++) {
+			if (strcmp(queries[i].name, tok) == 0 && *param == '\0') {
+				qrys[n] = &queries[i];
+			}
+		}
+		if (cmds[n] == NULL && qrys[n] == NULL) {
+			ipcreply(conn, "error unknown command: %s%s%s", tok, *param ? " " : "", param);
+			return;
+		}
+		n++;
+	}
+
+	for (int i = 0; i < n; i++) {
+		if (qrys[i] != NULL) {
+			qrys[i]->func(conn);
+		} else if (strcmp(cmds[i]->param ? cmds[i]->param : "", "*") == 0) {
+			cmds[i]->func(&(Arg){.v = params[i]});
+		} else {
+			cmds[i]->func(&cmds[i]->arg);
+		}
+	}
+	ipcreply(conn, "ok");
 }
 
-void swapprev(Client *c, Client **head) {
-	if (c == NULL || head == NULL || c->prev == NULL || *head == NULL) return;
+// monitor <index> <x> <y> <width> <height> <focused> <bar> <clients> <workspace>
+void querymonitors(IpcConn *conn) {
+	int i = 0;
+	for (Monitor *m = mons; m != NULL; m = m->next, i++) {
+		int n = 0;
+		for (Client *c = m->sel->clients; c != NULL; c = c->next) {
+			n++;
+		}
+		ipcreply(conn, "monitor %d %d %d %d %d %d %d %d %d", i, m->posx, m->posy, m->width, m->height, m == fmon, m->bar, n, (int)(m->sel - m->ws) + 1);
+	}
+}
 
-	Client *o = c->prev;
-	Client *left = o->prev;
-	Client *right = c->next;
+// client <window> <monitor> <workspace> <x> <y> <width> <height> <focused> <title>
+void queryclients(IpcConn *conn) {
+	int i = 0;
+	for (Monitor *m = mons; m != NULL; m = m->next, i++) {
+		int x, y, w, h;
+		monarea(m, &x, &y, &w, &h);
+		for (int k = 0; k < NWORKSPACES; k++) {
+			Workspace *ws = &m->ws[k];
+			for (Client *c = ws->clients; c != NULL; c = c->next) {
+				// any client can put a newline into its title, which would
+				// end the reply line early and fake the ones after it
+				char title[sizeof(c->name)];
+				size_t j = 0;
+				for (; c->name[j] != '\0'; j++) {
+					unsigned char ch = c->name[j];
+					title[j] = ch < 0x20 || ch == 0x7f ? ' ' : ch;
+				}
+				title[j] = '\0';
+				ipcreply(conn, "client 0x%lx %d %d %d %d %d %d %d %s", c->wnd, i, k + 1, x, y, w, h, m == fmon && c == m->sel->focused, title);
+			}
+		}
+	}
+}
 
-	if (left != NULL) left->next = c;
-	if (right != NULL) right->prev = o;
+// fetch and remove the state of the previous instance, True on a restart
+Bool loadstate() {
+	Atom type;
+	int format;
+	unsigned long after;
+	unsigned char *data = NULL;
 
-	o->next = right;
-	c->prev = left;
+	if (ROUNDTRIP(XGetWindowProperty(dpy, root, atoms[IWMState], 0, LONG_MAX / 4, True, XA_CARDINAL,
+			&type, &format, &nstate, &after, &data)) != Success || data == NULL) {
+		return False;
+	}
+	if (type != XA_CARDINAL || format != 32 || nstate < 4 || ((long *)data)[0] != STATE_VERSION) {
+		XFree(data);
+		nstate = 0;
+		return False;
+	}
+	state = (long *)data;
+	return True;
+}
+
+// leave the monitor and workspace assignment, list order, focus and bars to
+// the next instance, see STATE_VERSION for the layout
+void savestate() {
+	unsigned long n = 4;
+	for (Monitor *m = mons; m != NULL; m = m->next) {
+		n += 2 + 2 * NWORKSPACES;
+		for (Workspace *ws = m->ws; ws < m->ws + NWORKSPACES; ws++) {
+			for (Client *c = ws->clients; c != NULL; c = c->next) {
+				n++;
+			}
+		}
+	}
 
-	o->prev = c;
-	c->next = o;
+	long *data = malloc(n * sizeof(long));
+	if (data == NULL) return;
 
-	if (o == *head) *head = c;
+	long *p = data + 4;
+	int nmons = 0;
+	int fidx = 0;
+	for (Monitor *m = mons; m != NULL; m = m->next, nmons++) {
+		if (m == fmon) {
+			fidx = nmons;
+		}
+		*p++ = m->bar;
+		*p++ = m->sel - m->ws;
+		for (Workspace *ws = m->ws; ws < m->ws + NWORKSPACES; ws++) {
+			long *count = p + 1;
+			*p++ = ws->focused != NULL ? ws->focused->wnd : None;
+			*p++ = 0;
+			for (Client *c = ws->clients; c != NULL; c = c->next) {
+				*p++ = c->wnd;
+				(*count)++;
+			}
+		}
+	}
+	data[0] = STATE_VERSION;
+	data[1] = fidx;
+	data[2] = nmons;
+	data[3] = NWORKSPACES;
+
+	XChangeProperty(dpy, root, atoms[IWMState], XA_CARDINAL, 32, PropModeReplace, (unsigned char *)data, n);
+	ROUNDTRIP(XSync(dpy, False));
+	free(data);
 }
 
-void setup() {
-	signal(SIGHUP, sighup);
-	signal(SIGTERM, sigterm);
+// put the clients scan() found back where the previous instance had them,
+// one table lookup per saved window, windows it didn't know stay where
+// manage() put them
+void restorestate() {
+	if (state == NULL) return;
+
+	long *p = state + 4;
+	long *end = state + nstate;
+	long fidx = state[1];
+	long nws = state[3];
+	Monitor *m = mons;
+
+	for (long i = 0; i < state[2] && end - p >= 2; i++) {
+		// clients of monitors that are gone since end up on the first one
+		Monitor *dst = m != NULL ? m : mons;
+		if (m != NULL) {
+			m->bar = p[0];
+			if (p[1] >= 0 && p[1] < NWORKSPACES) {
+				m->sel = &m->ws[p[1]];
+			}
+			if (i == fidx) {
+				fmon = m;
+			}
+		}
+		p += 2;
 
-	dpy = XOpenDisplay(NULL);
-	if (dpy == NULL) {
-		panic("Could not open display...");
+		for (long k = 0; k < nws && end - p >= 2; k++) {
+			long n = p[1];
+			if (n < 0 || n > end - p - 2) {
+				p = end;
+				break;
+			}
+
+			// workspaces beyond the ones this build has end up on its last
+			Workspace *ws = &dst->ws[k < NWORKSPACES ? k : NWORKSPACES - 1];
+			for (long j = 0; j < n; j++) {
+				Client *c = wintoclient(p[2 + j]);
+				if (c == NULL) continue;
+				if (c->ws->focused == c) {
+					c->ws->focused = NULL;
+				}
+				ripclient(c, c->ws);
+				pushclient(c, ws);
+			}
+
+			Client *f = wintoclient(p[0]);
+			if (f != NULL && f->ws == ws) {
+				ws->focused = f;
+			}
+			p += 2 + n;
+		}
+
+		if (m != NULL) {
+			m = m->next;
+		}
 	}
 
-	root = DefaultRootWindow(dpy);
-	root_width = DisplayWidth(dpy, 0);
-	root_height = DisplayHeight(dpy, 0);
+	XFree(state);
+	state = NULL;
+	nstate = 0;
 
-	XSelectInput(dpy, root, SubstructureRedirectMask|SubstructureNotifyMask|PropertyChangeMask);
-	XSync(dpy, False);
+	// updatemon picks a focus for workspaces that lost theirs
+	for (m = mons; m != NULL; m = m->next) {
+		setdirty(m, DirtyLayout|DirtyFocus|DirtyBar);
+	}
+}
 
-	cursor = XCreateFontCursor(dpy, XC_X_cursor);
-	XDefineCursor(dpy, root, cursor);
-	XSync(dpy, False);
+// RandR reports the new root size, the monitors follow in refresh
+void screenchange(XEvent *e) {
+	XRRUpdateConfiguration(e);
+	root_width = DisplayWidth(dpy, DefaultScreen(dpy));
+	root_height = DisplayHeight(dpy, DefaultScreen(dpy));
+	geomdirty = True;
+}
 
-	initmons();
+static void replystat(const char *line, void *arg) {
+	ipcreply(arg, "stat %s", line);
+}
 
-//	// TODO: fix memory bullshit
-	grabkeys();
-	// prayge
-	XSync(dpy, False);
-	init();
-	// prayge
-	XSync(dpy, False);
+// stat <slot> <count> <mean us> <p50 us> <p99 us> <max us> <requests> <round trips> <histogram>
+void querystats(IpcConn *conn) {
+	statreport(replystat, conn);
+}
+
+// asked for explicitly, so it bypasses the level
+static void printstat(const char *line, void *arg) {
+	(void)arg;
+	logwrite(LogInfo, "stat %s", line);
+}
+
+// what the replayer can't tell from the event alone, see trace.h
+uint32_t traceflags(XEvent *ev) {
+	Window w;
+	switch (ev->type) {
+	case CreateNotify: w = ev->xcreatewindow.window; break;
+	case DestroyNotify: w = ev->xdestroywindow.window; break;
+	case UnmapNotify: w = ev->xunmap.window; break;
+	case MapNotify: w = ev->xmap.window; break;
+	case MapRequest: w = ev->xmaprequest.window; break;
+	case ConfigureNotify: w = ev->xconfigure.window; break;
+	case ConfigureRequest: w = ev->xconfigurerequest.window; break;
+	default: w = ev->xany.window; break;
+	}
+
+	uint32_t flags = 0;
+	WinEntry *e = wtlookup(w);
+	if (e != NULL && e->client == NULL) {
+		flags |= TraceOwn;
+	}
+	if (ev->type == UnmapNotify && e != NULL && e->client != NULL && ownunmap(e->client, &ev->xunmap)) {
+		flags |= TraceExpected;
+	}
+	return flags;
+}
+
+void reapchildren(int fd, void *arg) {
+	(void)fd;
+	(void)arg;
+	spawnreap(taskexited);
 }
 
 void run() {
 	XEvent ev;
-	XSync(dpy, False);
+	ROUNDTRIP(XSync(dpy, False));
+	refresh();
 	while (running) {
-		XNextEvent(dpy, &ev);
-		if (handler[ev.type]) {
-			handler[ev.type](&ev);
-		} else {
-#ifdef DEBUG
-			printf("No handler for event %d\n", ev.type);
+		// sleep until the server, a registered fd or a timer has news, but
+		// not while xlib already holds events for us
+		loopwait(XEventsQueued(dpy, QueuedAlready) ? 0 : -1);
+
+		if (dumpstats) {
+			statreport(printstat, NULL);
+			dumpstats = 0;
+		}
+
+		// take whatever is queued as one batch, every handler is timed and
+		// charged with the requests and round trips it made
+		for (int n = 0; running && n < MAX_BATCH && XPending(dpy); n++) {
+			XNextEvent(dpy, &ev);
+#ifdef BENCH
+			nevents++;
 #endif
+			uint32_t flags = tracing ? traceflags(&ev) : 0;
+			uint64_t start = statbegin();
+			unsigned long req = NextRequest(dpy);
+			unsigned long rt = nroundtrips;
+			int slot = ev.type < LASTEvent ? ev.type : StatOther;
+
+			if (randrbase >= 0 && ev.type == randrbase + RRScreenChangeNotify) {
+				slot = StatScreen;
+				screenchange(&ev);
+			} else if (ev.type < LASTEvent && handler[ev.type]) {
+				handler[ev.type](&ev);
+			} else {
+				LOG(LogDebug, "no handler for event %d", ev.type);
+			}
+
+			statend(slot, start, NextRequest(dpy) - req, nroundtrips - rt);
+			if (tracing) {
+				tracewrite(&ev, flags, start, NextRequest(dpy) - req);
+			}
+			if (nroundtrips != rt) {
+				LOG(LogDebug, "event %d made %lu round trips", ev.type, nroundtrips - rt);
+			}
+		}
+
+		uint64_t start = statbegin();
+		unsigned long req = NextRequest(dpy);
+		unsigned long rt = nroundtrips;
+		refresh();
+		statend(StatRefresh, start, NextRequest(dpy) - req, nroundtrips - rt);
+		if (nroundtrips != rt) {
+			LOG(LogDebug, "refresh made %lu round trips", nroundtrips - rt);
 		}
+		logkick();
 	}
 }
 
 int main(int argc, char *argv[]) {
+	// iwm -m command... talks to the running instance instead
+	if (argc > 2 && strcmp(argv[1], "-m") == 0) {
+		char path[108];
+		char msg[1024] = "";
+		for (int i = 2; i < argc; i++) {
+			if (i > 2) strncat(msg, " ", sizeof(msg) - strlen(msg) - 1);
+			strncat(msg, argv[i], sizeof(msg) - strlen(msg) - 1);
+		}
+		socketpath(path, sizeof(path));
+		return ipcsend(path, msg) < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+
 	setup();
 	scan();
+	restorestate();
 	run();
+	ipcclose();
+	// hidden clients stay hidden across a restart, see scan, but must not
+	// get lost when iwm goes away
+	if (!restart) {
+		for (Monitor *m = mons; m != NULL; m = m->next) {
+			for (Workspace *ws = m->ws; ws < m->ws + NWORKSPACES; ws++) {
+				for (Client *c = ws->clients; c != NULL; c = c->next) {
+					showclient(c);
+				}
+			}
+		}
+		ROUNDTRIP(XSync(dpy, False));
+	}
 	if (restart) {
+		savestate();
+		traceclose();
+		logsync();
 		execvp(argv[0], argv);
 	}
 	XCloseDisplay(dpy);
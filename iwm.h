@@ -1,18 +1,130 @@
+#ifndef IWM_H
+#define IWM_H
+
 #include <X11/X.h>
 #include <X11/Xft/Xft.h>
+#include "ipc.h"
+
+typedef struct Monitor Monitor;
+typedef struct Workspace Workspace;
+
+// atoms interned once at startup, see atomnames in iwm.c
+enum {
+	WMProtocols,
+	WMDelete,
+	WMState,
+	NetWMState,
+	NetWMStateHidden,
+	IWMState,
+#ifdef BENCH
+	IWMBench,
+#endif
+	AtomLast,
+};
+
+// layout of the _IWM_STATE root property a restarting iwm leaves behind:
+// version, focused monitor index, monitor count, workspace count and then
+// for every monitor bar visibility and selected workspace index, followed
+// by every workspace as focused window, client count and the client
+// windows in list order
+#define STATE_VERSION 2
+
+// workspaces every monitor has
+#define NWORKSPACES 9
+
+typedef union {
+	int i;
+	const void *v;
+} Arg;
+
+// a key binding, func gets called with arg when keysym is pressed with mod
+typedef struct Key Key;
+struct Key {
+	unsigned int mod;
+	KeySym keysym;
+	void (*func)(const Arg *);
+	const Arg arg;
+};
+
+// a control socket command, param is the word that has to follow name,
+// NULL for none and "*" to pass the rest of the line to func as arg.v
+typedef struct Command Command;
+struct Command {
+	const char *name;
+	const char *param;
+	void (*func)(const Arg *);
+	const Arg arg;
+};
+
+// a control socket query, func replies with one line per item
+typedef struct Query Query;
+struct Query {
+	const char *name;
+	void (*func)(IpcConn *conn);
+};
+
+// work a monitor owes the display, applied once at the end of an event batch
+enum {
+	DirtyLayout = 1 << 0,
+	DirtyFocus = 1 << 1,
+	DirtyBar = 1 << 2,
+	DirtyExpose = 1 << 3,
+};
 
 typedef struct Client Client;
 struct Client {
 	char name[64];
 	Window wnd;
+	Monitor *mon;
+	Workspace *ws;
+	// geometry last sent to the server, w is 0 before the first configure
+	int x, y, w, h;
+	// how much of name fits into a tab of fitw pixels, fitw is -1 when unknown
+	int fitw;
+	int fitlen;
+	// WM_NAME changed since the last fetch
+	Bool titledirty;
+	// unmapped by us because another client covers it, see hideclients
+	Bool hidden;
+	// UnmapNotify events caused by hiding that are still on their way and
+	// the serial of the oldest of those unmaps, a real unmap by the client
+	// that the server handled before it has a lower serial, see ownunmap
+	int ignoreunmap;
+	unsigned long unmapserial;
 	Client *prev;
 	Client *next;
 };
 
+// a horizontal slice of the bar as it was last painted into the back buffer
+enum { SegTab, SegSelTab, SegFill, SegEmpty, SegStatus };
+
+typedef struct BarSeg BarSeg;
+struct BarSeg {
+	int x;
+	int width;
+	int style;
+	char text[128];
+};
+
+// most built-in status modules a bar has room for
+#define MAX_STATUSMODS 8
+
+// measured text, cached by content so unchanged labels are never measured again
+#define TEXTCACHE_SIZE 64
+
+typedef struct TextExt TextExt;
+struct TextExt {
+	unsigned int hash;
+	char text[128];
+	int width;
+	// prefix of text that fits into fitw pixels, fitw is -1 when unknown
+	int fitw;
+	int fitlen;
+};
+
 typedef struct Bar Bar;
 struct Bar {
 	Window wnd;
-	char status[128];
 	int posx;
 	int posy;
 	int width;
@@ -27,9 +139,30 @@ struct Bar {
 	XftColor fg_color;
 	XftColor bg_color;
 	XftColor primary_color;
+	// back buffer, the window only ever gets copies of it
+	Pixmap buf;
+	GC gc;
+	// damage tracking, segs is what buf currently shows
+	BarSeg *segs;
+	BarSeg *next;
+	int nsegs;
+	int capsegs;
+	// extents of strings drawn with font
+	TextExt textcache[TEXTCACHE_SIZE];
+	// widest each status module has been, boxes don't shrink so a changing
+	// value doesn't move everything left of it
+	int statusw[MAX_STATUSMODS];
+};
+
+// a client list of a monitor with its own focus, only the selected one of
+// each monitor is on screen
+struct Workspace {
+	Client *clients;
+	Client *tail;
+	Client *focused;
+	Monitor *mon;
 };
 
-typedef struct Monitor Monitor;
 struct Monitor {
 	int posx;
 	int posy;
@@ -37,8 +170,13 @@ struct Monitor {
 	int height;
 	Bar *statusbar;
 	Bool bar;
-	Client *clients;
-	Client *focused;
+	int dirty;
+	Workspace ws[NWORKSPACES];
+	Workspace *sel;
+	// the client left mapped when hideclients is on
+	Client *shown;
 	Monitor *prev;
 	Monitor *next;
 };
+
+#endif
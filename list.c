@@ -0,0 +1,104 @@
+#include <stddef.h>
+#include "list.h"
+
+Client *ripclient(Client *c, Workspace *w) {
+	if (c == NULL || w == NULL || w->clients == NULL) return NULL;
+
+	Client *left = c->prev;
+	Client *right = c->next;
+
+	if (left != NULL) left->next = right;
+	if (right != NULL) right->prev = left;
+	if (c == w->clients) w->clients = right;
+	if (c == w->tail) w->tail = left;
+
+	c->next = NULL;
+	c->prev = NULL;
+	c->mon = NULL;
+	c->ws = NULL;
+
+	return c;
+}
+
+void pushclient(Client *c, Workspace *w) {
+	if (c == NULL || w == NULL) return;
+
+	c->mon = w->mon;
+	c->ws = w;
+	// truncation was measured with the old monitors bar font
+	c->fitw = -1;
+
+	c->prev = w->tail;
+	c->next = NULL;
+
+	if (w->tail != NULL) {
+		w->tail->next = c;
+	} else {
+		w->clients = c;
+	}
+	w->tail = c;
+}
+
+void insertafter(Client *c, Client *o, Workspace *w) {
+	if (c == NULL) return;
+	if (w == NULL) return;
+
+	c->mon = w->mon;
+	c->ws = w;
+
+	if (o == NULL) {
+		c->next = w->clients;
+		if (w->clients != NULL) w->clients->prev = c;
+		w->clients = c;
+		c->prev = NULL;
+	} else {
+		Client *right = o->next;
+
+		o->next = c;
+		c->prev = o;
+		c->next = right;
+		if (right != NULL) right->prev = c;
+	}
+
+	if (c->next == NULL) w->tail = c;
+}
+
+void swapnext(Client *c, Workspace *w) {
+	if (c == NULL || w == NULL || c->next == NULL || w->clients == NULL) return;
+
+	Client *o = c->next;
+	Client *left = c->prev;
+	Client *right = o->next;
+
+	if (left != NULL) left->next = o;
+	if (right != NULL) right->prev = c;
+
+	o->prev = left;
+	c->next = right;
+
+	o->next = c;
+	c->prev = o;
+
+	if (c == w->clients) w->clients = o;
+	if (o == w->tail) w->tail = c;
+}
+
+void swapprev(Client *c, Workspace *w) {
+	if (c == NULL || w == NULL || c->prev == NULL || w->clients == NULL) return;
+
+	Client *o = c->prev;
+	Client *left = o->prev;
+	Client *right = c->next;
+
+	if (left != NULL) left->next = c;
+	if (right != NULL) right->prev = o;
+
+	o->next = right;
+	c->prev = left;
+
+	o->prev = c;
+	c->next = o;
+
+	if (o == w->clients) w->clients = c;
+	if (c == w->tail) w->tail = o;
+}
@@ -0,0 +1,13 @@
+#ifndef LIST_H
+#define LIST_H
+
+#include "iwm.h"
+
+// linked list utils, every workspace keeps both ends of its client list
+Client *ripclient(Client *c, Workspace *w);
+void pushclient(Client *c, Workspace *w);
+void insertafter(Client *c, Client *o, Workspace *w);
+void swapnext(Client *c, Workspace *w);
+void swapprev(Client *c, Workspace *w);
+
+#endif
@@ -0,0 +1,176 @@
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+#include "util.h"
+#include "log.h"
+
+// a power of two, records are fixed size so logging never allocates
+#define LOG_RECORDS 1024
+#define LOG_MSG 112
+
+typedef struct LogRec LogRec;
+struct LogRec {
+	int64_t ns;
+	int level;
+	char msg[LOG_MSG];
+};
+
+static const char *levelnames[] = {
+	[LogError] = "error",
+	[LogWarn] = "warn",
+	[LogInfo] = "info",
+	[LogDebug] = "debug",
+};
+
+#ifdef DEBUG
+int loglevel = LogDebug;
+#else
+int loglevel = LogWarn;
+#endif
+
+// single producer, the wm thread, and a single consumer at a time, the
+// writer thread or logsync, head and tail only ever grow
+static LogRec ring[LOG_RECORDS];
+static atomic_ulong head = 0;
+static atomic_ulong tail = 0;
+static atomic_ulong dropped = 0;
+// head at the last logkick, only touched by the wm thread
+static unsigned long kicked = 0;
+static int wakefd = -1;
+static pthread_mutex_t drainlock = PTHREAD_MUTEX_INITIALIZER;
+
+static void writeall(const char *buf, size_t len) {
+	while (len > 0) {
+		ssize_t n = write(STDERR_FILENO, buf, len);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			return;
+		}
+		buf += n;
+		len -= n;
+	}
+}
+
+// format and write everything between tail and head
+static void drain() {
+	char buf[8192];
+	size_t len = 0;
+
+	pthread_mutex_lock(&drainlock);
+	unsigned long t = atomic_load_explicit(&tail, memory_order_relaxed);
+	unsigned long h = atomic_load_explicit(&head, memory_order_acquire);
+	for (; t != h; t++) {
+		LogRec *r = &ring[t & (LOG_RECORDS - 1)];
+		if (len > sizeof(buf) - LOG_MSG - 64) {
+			writeall(buf, len);
+			len = 0;
+		}
+
+		time_t sec = r->ns / 1000000000;
+		struct tm tm;
+		localtime_r(&sec, &tm);
+		len += snprintf(buf + len, sizeof(buf) - len, "iwm: %02d:%02d:%02d.%03d %s: %s\n",
+			tm.tm_hour, tm.tm_min, tm.tm_sec, (int)(r->ns / 1000000 % 1000), levelnames[r->level], r->msg);
+		// the slot may be reused once tail passes it
+		atomic_store_explicit(&tail, t + 1, memory_order_release);
+	}
+
+	unsigned long d = atomic_exchange(&dropped, 0);
+	if (d > 0) {
+		len += snprintf(buf + len, sizeof(buf) - len, "iwm: log ring full, dropped %lu records\n", d);
+	}
+	writeall(buf, len);
+	pthread_mutex_unlock(&drainlock);
+}
+
+// stderr may be a slow pipe, waiting for it here keeps the wm responsive
+static void *writer(void *arg) {
+	(void)arg;
+	uint64_t n;
+	for (;;) {
+		if (read(wakefd, &n, sizeof(n)) < 0 && errno != EINTR) {
+			return NULL;
+		}
+		drain();
+	}
+}
+
+void loginit() {
+	const char *env = getenv("IWM_LOG");
+	if (env != NULL && logsetlevel(env) < 0) {
+		LOG(LogWarn, "unknown log level %s", env);
+	}
+
+	wakefd = eventfd(0, EFD_CLOEXEC);
+	if (wakefd < 0) {
+		panic("Could not create log eventfd...");
+	}
+
+	// signals have to wake up the main loop, not the writer
+	sigset_t all, old;
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+	pthread_t thread;
+	if (pthread_create(&thread, NULL, writer, NULL) != 0) {
+		panic("Could not start log writer...");
+	}
+	pthread_detach(thread);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+	// panic and the default X error handler exit, keep their last words
+	atexit(logsync);
+}
+
+void logwrite(int level, const char *fmt, ...) {
+	unsigned long h = atomic_load_explicit(&head, memory_order_relaxed);
+	if (h - atomic_load_explicit(&tail, memory_order_acquire) == LOG_RECORDS) {
+		atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+		return;
+	}
+
+	LogRec *r = &ring[h & (LOG_RECORDS - 1)];
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	r->ns = (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+	r->level = level;
+
+	va_list ap;
+	va_start(ap, fmt);
+	vsnprintf(r->msg, sizeof(r->msg), fmt, ap);
+	va_end(ap);
+
+	atomic_store_explicit(&head, h + 1, memory_order_release);
+}
+
+void logkick() {
+	unsigned long h = atomic_load_explicit(&head, memory_order_relaxed);
+	if (h == kicked || wakefd < 0) return;
+	kicked = h;
+
+	uint64_t one = 1;
+	// fails only with the counter saturated, the writer is busy then anyway
+	if (write(wakefd, &one, sizeof(one)) < 0) return;
+}
+
+void logsync() {
+	drain();
+}
+
+int logsetlevel(const char *name) {
+	for (size_t i = 0; i < sizeof(levelnames) / sizeof(levelnames[0]); i++) {
+		if (strcmp(levelnames[i], name) == 0) {
+			loglevel = i;
+			return 0;
+		}
+	}
+	return -1;
+}
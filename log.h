@@ -0,0 +1,23 @@
+#ifndef LOG_H
+#define LOG_H
+
+enum { LogError, LogWarn, LogInfo, LogDebug };
+
+// records above loglevel are dropped before anything is formatted
+extern int loglevel;
+
+#define LOG(level, ...) do { if ((level) <= loglevel) logwrite((level), __VA_ARGS__); } while (0)
+
+// start the writer thread, the level comes from $IWM_LOG
+void loginit();
+// queue a record, never blocks, a full ring drops it
+void logwrite(int level, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+// hand what was queued since the last call to the writer, the main loop
+// calls this once per iteration so a burst costs one wakeup
+void logkick();
+// write out everything queued from the calling thread, before exec or exit
+void logsync();
+// set the level by name, returns -1 for an unknown one
+int logsetlevel(const char *name);
+
+#endif
@@ -0,0 +1,208 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+#include "util.h"
+#include "loop.h"
+
+#define MAX_READY 16
+
+typedef struct Watch Watch;
+struct Watch {
+	int fd;
+	FdFunc func;
+	void *arg;
+	Watch *next;
+};
+
+// pending timers ordered by deadline, the timerfd is armed for the first
+// one only, so an idle wm doesn't tick
+typedef struct Timer Timer;
+struct Timer {
+	int id;
+	int64_t deadline;
+	long interval;
+	TimerFunc func;
+	void *arg;
+	int cancelled;
+	Timer *next;
+};
+
+static int epfd = -1;
+static int tfd = -1;
+static Watch *watches = NULL;
+// removed watches, freed once loopwait is done with its ready list
+static Watch *dead = NULL;
+static Timer *timers = NULL;
+static Timer *firing = NULL;
+static int lastid = 0;
+
+static int64_t nowns() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void armtimer() {
+	struct itimerspec its;
+	memset(&its, 0, sizeof(its));
+	if (timers != NULL) {
+		// an all zero value would disarm it
+		int64_t deadline = timers->deadline > 0 ? timers->deadline : 1;
+		its.it_value.tv_sec = deadline / 1000000000;
+		its.it_value.tv_nsec = deadline % 1000000000;
+	}
+	timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+static void inserttimer(Timer *t) {
+	Timer **p = &timers;
+	while (*p != NULL && (*p)->deadline <= t->deadline) {
+		p = &(*p)->next;
+	}
+	t->next = *p;
+	*p = t;
+}
+
+static void firetimers() {
+	uint64_t expirations;
+	while (read(tfd, &expirations, sizeof(expirations)) > 0);
+
+	int64_t now = nowns();
+	while (timers != NULL && timers->deadline <= now) {
+		Timer *t = timers;
+		timers = t->next;
+
+		firing = t;
+		t->func(t->arg);
+		firing = NULL;
+
+		if (t->interval > 0 && !t->cancelled) {
+			// skip ticks we slept through instead of firing them in a burst
+			do {
+				t->deadline += (int64_t)t->interval * 1000000;
+			} while (t->deadline <= now);
+			inserttimer(t);
+		} else {
+			free(t);
+		}
+	}
+	armtimer();
+}
+
+void loopinit() {
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+	tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (epfd < 0 || tfd < 0) {
+		panic("Could not set up the main loop...");
+	}
+
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.ptr = NULL;
+	epoll_ctl(epfd, EPOLL_CTL_ADD, tfd, &ev);
+}
+
+void loopaddfd(int fd, FdFunc func, void *arg) {
+	Watch *w = malloc(sizeof(Watch));
+	if (w == NULL) {
+		panic("Could not allocate fd watch...");
+	}
+	w->fd = fd;
+	w->func = func;
+	w->arg = arg;
+	w->next = watches;
+
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.ptr = w;
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		free(w);
+		return;
+	}
+	watches = w;
+}
+
+void loopdelfd(int fd) {
+	for (Watch **p = &watches; *p != NULL; p = &(*p)->next) {
+		if ((*p)->fd == fd) {
+			Watch *w = *p;
+			*p = w->next;
+			epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL);
+			// a later entry of the current ready list may still point here
+			w->func = NULL;
+			w->next = dead;
+			dead = w;
+			return;
+		}
+	}
+}
+
+void loopwait(int timeout) {
+	struct epoll_event ready[MAX_READY];
+
+	int n = epoll_wait(epfd, ready, MAX_READY, timeout);
+	if (n < 0) {
+		// signals just wake us up
+		if (errno != EINTR) {
+			panic("epoll_wait failed...");
+		}
+		return;
+	}
+
+	for (int i = 0; i < n; i++) {
+		Watch *w = ready[i].data.ptr;
+		if (w == NULL) {
+			firetimers();
+		} else if (w->func != NULL) {
+			w->func(w->fd, w->arg);
+		}
+	}
+
+	while (dead != NULL) {
+		Watch *w = dead;
+		dead = w->next;
+		free(w);
+	}
+}
+
+int timeradd(long ms, long interval, TimerFunc func, void *arg) {
+	Timer *t = malloc(sizeof(Timer));
+	if (t == NULL) {
+		panic("Could not allocate timer...");
+	}
+	t->id = ++lastid;
+	t->deadline = nowns() + (int64_t)ms * 1000000;
+	t->interval = interval;
+	t->func = func;
+	t->arg = arg;
+	t->cancelled = 0;
+
+	inserttimer(t);
+	if (timers == t) {
+		armtimer();
+	}
+	return t->id;
+}
+
+void timerdel(int id) {
+	if (firing != NULL && firing->id == id) {
+		firing->cancelled = 1;
+		return;
+	}
+	for (Timer **p = &timers; *p != NULL; p = &(*p)->next) {
+		if ((*p)->id == id) {
+			Timer *t = *p;
+			*p = t->next;
+			free(t);
+			armtimer();
+			return;
+		}
+	}
+}
@@ -0,0 +1,22 @@
+#ifndef LOOP_H
+#define LOOP_H
+
+// main loop plumbing, everything the wm waits on besides its own event
+// queue is a descriptor registered here or a timer
+typedef void (*FdFunc)(int fd, void *arg);
+typedef void (*TimerFunc)(void *arg);
+
+void loopinit();
+// func may be NULL when the descriptor only has to wake the loop up
+void loopaddfd(int fd, FdFunc func, void *arg);
+void loopdelfd(int fd);
+// sleep at most timeout ms (-1 for no limit) and run the handlers of
+// whatever became ready
+void loopwait(int timeout);
+
+// fire func after ms and then every interval ms, or once if interval is 0
+// returns an id for timerdel, timers may delete themselves
+int timeradd(long ms, long interval, TimerFunc func, void *arg);
+void timerdel(int id);
+
+#endif
@@ -0,0 +1,53 @@
+#include <stdlib.h>
+#include "util.h"
+#include "pool.h"
+
+// slabs start with a link to the previous slab, objects follow aligned
+typedef union SlabHead SlabHead;
+union SlabHead {
+	void *next;
+	max_align_t align;
+};
+
+void poolinit(Pool *p, size_t size, size_t perslab) {
+	// free objects hold the free list link, keep them pointer aligned
+	if (size < sizeof(void *)) size = sizeof(void *);
+	size = (size + sizeof(max_align_t) - 1) & ~(sizeof(max_align_t) - 1);
+
+	p->size = size;
+	p->perslab = perslab ? perslab : 1;
+	p->free = NULL;
+	p->slabs = NULL;
+}
+
+static void poolgrow(Pool *p) {
+	SlabHead *slab = malloc(sizeof(SlabHead) + p->size * p->perslab);
+	if (slab == NULL) {
+		panic("Could not grow pool...");
+	}
+	slab->next = p->slabs;
+	p->slabs = slab;
+
+	// thread the new objects onto the free list, first one ends up on top
+	char *objs = (char *)(slab + 1);
+	for (size_t i = p->perslab; i-- > 0;) {
+		void *obj = objs + i * p->size;
+		*(void **)obj = p->free;
+		p->free = obj;
+	}
+}
+
+void *poolalloc(Pool *p) {
+	if (p->free == NULL) {
+		poolgrow(p);
+	}
+	void *obj = p->free;
+	p->free = *(void **)obj;
+	return obj;
+}
+
+void poolfree(Pool *p, void *obj) {
+	if (obj == NULL) return;
+	*(void **)obj = p->free;
+	p->free = obj;
+}
@@ -0,0 +1,20 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+// fixed size object allocator, objects are carved out of slabs that are
+// never returned to the system and recycled through a free list
+typedef struct Pool Pool;
+struct Pool {
+	size_t size;
+	size_t perslab;
+	void *free;
+	void *slabs;
+};
+
+void poolinit(Pool *p, size_t size, size_t perslab);
+void *poolalloc(Pool *p);
+void poolfree(Pool *p, void *obj);
+
+#endif
@@ -0,0 +1,113 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "util.h"
+#include "log.h"
+#include "proc.h"
+
+#define MAX_ARGS 64
+
+extern char **environ;
+
+// anything here means the command needs a real shell
+static const char shellchars[] = "|&;<>()$`\\\"'*?[]#~={}%\n";
+
+static int chldpipe[2] = { -1, -1 };
+
+static void sigchld() {
+	int saved = errno;
+	// a full pipe already has a wakeup pending
+	write(chldpipe[1], "", 1);
+	errno = saved;
+}
+
+int spawninit() {
+	if (pipe(chldpipe) < 0) {
+		panic("Could not create SIGCHLD pipe...");
+	}
+	for (int i = 0; i < 2; i++) {
+		fcntl(chldpipe[i], F_SETFD, FD_CLOEXEC);
+		fcntl(chldpipe[i], F_SETFL, O_NONBLOCK);
+	}
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = sigchld;
+	sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGCHLD, &sa, NULL);
+
+	return chldpipe[0];
+}
+
+void spawnreap(void (*exited)(pid_t pid, int status)) {
+	char buf[64];
+	while (read(chldpipe[0], buf, sizeof(buf)) > 0);
+
+	pid_t pid;
+	int status;
+	while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+		if (exited != NULL) {
+			exited(pid, status);
+		}
+	}
+}
+
+pid_t spawncmd(const char *cmd) {
+	char buf[256];
+	char *argv[MAX_ARGS + 1];
+	int argc = 0;
+
+	// split simple commands on blanks so they skip the shell
+	if (strpbrk(cmd, shellchars) == NULL && strlen(cmd) < sizeof(buf)) {
+		strcpy(buf, cmd);
+		for (char *tok = strtok(buf, " \t"); tok != NULL && argc < MAX_ARGS; tok = strtok(NULL, " \t")) {
+			argv[argc++] = tok;
+		}
+		// too many arguments, let the shell deal with it
+		if (strtok(NULL, " \t") != NULL) {
+			argc = 0;
+		}
+	}
+	const char *file = argv[0];
+	if (argc == 0) {
+		file = "/bin/sh";
+		argv[argc++] = "sh";
+		argv[argc++] = "-c";
+		argv[argc++] = (char *)cmd;
+	}
+	argv[argc] = NULL;
+
+	posix_spawnattr_t attr;
+	posix_spawnattr_init(&attr);
+	// the child gets default handlers and its own session, so closing the
+	// wm or its terminal doesn't take it down
+	sigset_t defaults;
+	sigemptyset(&defaults);
+	sigaddset(&defaults, SIGCHLD);
+	sigaddset(&defaults, SIGHUP);
+	sigaddset(&defaults, SIGTERM);
+	sigaddset(&defaults, SIGPIPE);
+	posix_spawnattr_setsigdefault(&attr, &defaults);
+	short flags = POSIX_SPAWN_SETSIGDEF;
+#ifdef POSIX_SPAWN_SETSID
+	flags |= POSIX_SPAWN_SETSID;
+#endif
+	posix_spawnattr_setflags(&attr, flags);
+
+	pid_t pid;
+	int err = posix_spawnp(&pid, file, NULL, &attr, argv, environ);
+	posix_spawnattr_destroy(&attr);
+
+	if (err != 0) {
+		LOG(LogWarn, "could not spawn %s: %s", cmd, strerror(err));
+		return -1;
+	}
+	return pid;
+}
@@ -0,0 +1,17 @@
+#ifndef PROC_H
+#define PROC_H
+
+#include <sys/types.h>
+
+// start a command in its own session, returns the pid or -1
+// commands without shell syntax are executed directly, the rest go
+// through /bin/sh -c
+pid_t spawncmd(const char *cmd);
+
+// install the SIGCHLD handler, returns a descriptor that becomes readable
+// whenever children have exited
+int spawninit();
+// reap every exited child, exited gets called for each one
+void spawnreap(void (*exited)(pid_t pid, int status));
+
+#endif
@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "stats.h"
+
+static Stat stats[StatSlots];
+
+static const char *slotnames[StatSlots] = {
+	[KeyPress] = "KeyPress",
+	[KeyRelease] = "KeyRelease",
+	[ButtonPress] = "ButtonPress",
+	[ButtonRelease] = "ButtonRelease",
+	[MotionNotify] = "MotionNotify",
+	[EnterNotify] = "EnterNotify",
+	[LeaveNotify] = "LeaveNotify",
+	[FocusIn] = "FocusIn",
+	[FocusOut] = "FocusOut",
+	[KeymapNotify] = "KeymapNotify",
+	[Expose] = "Expose",
+	[GraphicsExpose] = "GraphicsExpose",
+	[NoExpose] = "NoExpose",
+	[VisibilityNotify] = "VisibilityNotify",
+	[CreateNotify] = "CreateNotify",
+	[DestroyNotify] = "DestroyNotify",
+	[UnmapNotify] = "UnmapNotify",
+	[MapNotify] = "MapNotify",
+	[MapRequest] = "MapRequest",
+	[ReparentNotify] = "ReparentNotify",
+	[ConfigureNotify] = "ConfigureNotify",
+	[ConfigureRequest] = "ConfigureRequest",
+	[GravityNotify] = "GravityNotify",
+	[ResizeRequest] = "ResizeRequest",
+	[CirculateNotify] = "CirculateNotify",
+	[CirculateRequest] = "CirculateRequest",
+	[PropertyNotify] = "PropertyNotify",
+	[SelectionClear] = "SelectionClear",
+	[SelectionRequest] = "SelectionRequest",
+	[SelectionNotify] = "SelectionNotify",
+	[ColormapNotify] = "ColormapNotify",
+	[ClientMessage] = "ClientMessage",
+	[MappingNotify] = "MappingNotify",
+	[GenericEvent] = "GenericEvent",
+	[StatScreen] = "ScreenChange",
+	[StatOther] = "other",
+	[StatRefresh] = "refresh",
+};
+
+uint64_t statbegin() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void statend(int slot, uint64_t start, unsigned long requests, unsigned long roundtrips) {
+	if (slot < 0 || slot >= StatSlots) return;
+
+	uint64_t ns = statbegin() - start;
+	Stat *s = &stats[slot];
+	s->count++;
+	s->requests += requests;
+	s->roundtrips += roundtrips;
+	s->totalns += ns;
+	if (ns > s->maxns) {
+		s->maxns = ns;
+	}
+
+	int b = 0;
+	for (uint64_t us = ns / 2000; us > 0 && b < STAT_BUCKETS - 1; us >>= 1) {
+		b++;
+	}
+	s->hist[b]++;
+}
+
+// upper bound of the bucket the given share of runs falls into, in us
+static unsigned long percentile(Stat *s, int permille) {
+	unsigned long want = (s->count * permille + 999) / 1000;
+	unsigned long seen = 0;
+	unsigned long max = s->maxns / 1000;
+	for (int b = 0; b < STAT_BUCKETS - 1; b++) {
+		seen += s->hist[b];
+		if (seen >= want) {
+			return (2UL << b) < max ? (2UL << b) : max;
+		}
+	}
+	return max;
+}
+
+// <slot> <count> <mean us> <p50 us> <p99 us> <max us> <requests> <round trips> <histogram>
+void statreport(void (*out)(const char *line, void *arg), void *arg) {
+	char line[512];
+
+	for (int i = 0; i < StatSlots; i++) {
+		Stat *s = &stats[i];
+		if (s->count == 0) continue;
+
+		char name[16];
+		if (slotnames[i] != NULL) {
+			snprintf(name, sizeof(name), "%s", slotnames[i]);
+		} else {
+			snprintf(name, sizeof(name), "event%d", i);
+		}
+
+		int n = snprintf(line, sizeof(line), "%s %lu %lu %lu %lu %lu %lu %lu ", name, s->count,
+			(unsigned long)(s->totalns / s->count / 1000), percentile(s, 500), percentile(s, 990),
+			(unsigned long)(s->maxns / 1000), s->requests, s->roundtrips);
+		for (int b = 0; b < STAT_BUCKETS && n < (int)sizeof(line); b++) {
+			n += snprintf(line + n, sizeof(line) - n, b ? ",%lu" : "%lu", s->hist[b]);
+		}
+		out(line, arg);
+	}
+}
+
+void statreset() {
+	memset(stats, 0, sizeof(stats));
+}
@@ -0,0 +1,41 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <X11/X.h>
+
+// always on counters for the main loop, one slot per core event type plus
+// a few for extension events and work that isn't an event, extension event
+// types are assigned at runtime and can be any number from LASTEvent on, so
+// callers map them to StatScreen or StatOther instead of using the type
+enum {
+	StatScreen = LASTEvent,
+	StatOther,
+	StatRefresh,
+	StatSlots,
+};
+
+// handler latency histogram buckets, bucket i counts times below 2^(i+1)
+// microseconds, the last one everything slower
+#define STAT_BUCKETS 16
+
+typedef struct Stat Stat;
+struct Stat {
+	unsigned long count;
+	unsigned long requests;
+	unsigned long roundtrips;
+	uint64_t totalns;
+	uint64_t maxns;
+	unsigned long hist[STAT_BUCKETS];
+};
+
+// monotonic timestamp to hand to statend
+uint64_t statbegin();
+// account one run of slot that started at start, issued requests X
+// requests and waited for roundtrips replies
+void statend(int slot, uint64_t start, unsigned long requests, unsigned long roundtrips);
+// call out once per slot that has run with a line describing it
+void statreport(void (*out)(const char *line, void *arg), void *arg);
+void statreset();
+
+#endif
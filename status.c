@@ -0,0 +1,99 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "status.h"
+
+// the files stay open between updates, procfs and sysfs regenerate their
+// contents for every read from offset 0
+typedef struct OpenFile OpenFile;
+struct OpenFile {
+	char path[128];
+	int fd;
+};
+
+#define MAX_FILES 8
+
+static OpenFile files[MAX_FILES];
+static int nfiles = 0;
+
+static int readfile(const char *path, char *buf, size_t len) {
+	int i;
+	for (i = 0; i < nfiles; i++) {
+		if (strcmp(files[i].path, path) == 0) break;
+	}
+	if (i == nfiles) {
+		int fd = open(path, O_RDONLY | O_CLOEXEC);
+		if (fd < 0) return -1;
+		if (nfiles == MAX_FILES) {
+			// no room to keep it open, read it once
+			ssize_t n = read(fd, buf, len - 1);
+			close(fd);
+			if (n < 0) return -1;
+			buf[n] = '\0';
+			return n;
+		}
+		strncpy(files[i].path, path, sizeof(files[i].path) - 1);
+		files[i].path[sizeof(files[i].path) - 1] = '\0';
+		files[i].fd = fd;
+		nfiles++;
+	}
+
+	ssize_t n = pread(files[i].fd, buf, len - 1, 0);
+	if (n < 0) return -1;
+	buf[n] = '\0';
+	return n;
+}
+
+int statusclock(char *buf, size_t len, const char *arg) {
+	time_t t = time(NULL);
+	struct tm tm;
+	localtime_r(&t, &tm);
+	if (strftime(buf, len, arg ? arg : "%H:%M", &tm) == 0) return -1;
+	return 0;
+}
+
+int statusload(char *buf, size_t len, const char *arg) {
+	(void)arg;
+	char data[128];
+	if (readfile("/proc/loadavg", data, sizeof(data)) < 0) return -1;
+
+	double load;
+	if (sscanf(data, "%lf", &load) != 1) return -1;
+	snprintf(buf, len, "load %.2f", load);
+	return 0;
+}
+
+static long meminfo(const char *data, const char *key) {
+	const char *p = strstr(data, key);
+	if (p == NULL) return -1;
+	return strtol(p + strlen(key), NULL, 10);
+}
+
+int statusmem(char *buf, size_t len, const char *arg) {
+	(void)arg;
+	char data[4096];
+	if (readfile("/proc/meminfo", data, sizeof(data)) < 0) return -1;
+
+	long total = meminfo(data, "MemTotal:");
+	long avail = meminfo(data, "MemAvailable:");
+	if (total <= 0 || avail < 0) return -1;
+	snprintf(buf, len, "mem %ld%%", (total - avail) * 100 / total);
+	return 0;
+}
+
+int statusbattery(char *buf, size_t len, const char *arg) {
+	char path[128];
+	char capacity[16];
+	char state[32];
+
+	snprintf(path, sizeof(path), "/sys/class/power_supply/%s/capacity", arg ? arg : "BAT0");
+	if (readfile(path, capacity, sizeof(capacity)) < 0) return -1;
+	snprintf(path, sizeof(path), "/sys/class/power_supply/%s/status", arg ? arg : "BAT0");
+	if (readfile(path, state, sizeof(state)) < 0) state[0] = '\0';
+
+	snprintf(buf, len, "bat %d%%%s", atoi(capacity), strncmp(state, "Charging", 8) == 0 ? "+" : "");
+	return 0;
+}
@@ -0,0 +1,24 @@
+#ifndef STATUS_H
+#define STATUS_H
+
+#include <stddef.h>
+
+// a built-in status producer, func writes the text for the bar into buf and
+// returns -1 when it has nothing to show, it is rerun every interval ms
+typedef struct StatusMod StatusMod;
+struct StatusMod {
+	int (*func)(char *buf, size_t len, const char *arg);
+	const char *arg;
+	long interval;
+};
+
+// arg is a strftime format
+int statusclock(char *buf, size_t len, const char *arg);
+// 1 minute load average
+int statusload(char *buf, size_t len, const char *arg);
+// share of memory in use
+int statusmem(char *buf, size_t len, const char *arg);
+// arg names the battery under /sys/class/power_supply
+int statusbattery(char *buf, size_t len, const char *arg);
+
+#endif
@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include "util.h"
+#include "log.h"
+#include "proc.h"
+#include "tasks.h"
+
+enum { TaskWaiting, TaskRunning, TaskDone };
+
+typedef struct TaskState TaskState;
+struct TaskState {
+	int state;
+	pid_t pid;
+	struct timespec start;
+};
+
+static const Task *tasks = NULL;
+static TaskState *states = NULL;
+static int ntasks = 0;
+
+static long elapsedms(struct timespec *start) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1000 + (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+static void launch(int i);
+
+// log how long the task took and start everything that waited for it
+static void finish(int i, int status) {
+	states[i].state = TaskDone;
+
+	if (status != 0) {
+		LOG(LogWarn, "task %s failed with status %d after %ld ms", tasks[i].name, status, elapsedms(&states[i].start));
+	} else {
+		// written whatever the level, this is what the table is tuned by
+		logwrite(LogInfo, "task %s took %ld ms", tasks[i].name, elapsedms(&states[i].start));
+	}
+
+	for (int j = 0; j < ntasks; j++) {
+		if (states[j].state == TaskWaiting && tasks[j].after != NULL && strcmp(tasks[j].after, tasks[i].name) == 0) {
+			launch(j);
+		}
+	}
+}
+
+static void launch(int i) {
+	clock_gettime(CLOCK_MONOTONIC, &states[i].start);
+	states[i].state = TaskRunning;
+
+	if (tasks[i].cmd != NULL) {
+		states[i].pid = spawncmd(tasks[i].cmd);
+		if (states[i].pid < 0) {
+			finish(i, -1);
+		}
+	} else {
+		if (tasks[i].func != NULL) {
+			tasks[i].func();
+		}
+		finish(i, 0);
+	}
+}
+
+static int hasdep(int i) {
+	if (tasks[i].after == NULL) return 0;
+	for (int j = 0; j < ntasks; j++) {
+		if (j != i && strcmp(tasks[j].name, tasks[i].after) == 0) {
+			return 1;
+		}
+	}
+	LOG(LogWarn, "task %s waits for unknown task %s, starting it now", tasks[i].name, tasks[i].after);
+	return 0;
+}
+
+void taskstart(const Task *t, int n) {
+	tasks = t;
+	ntasks = n;
+	states = calloc(n, sizeof(TaskState));
+	if (states == NULL) {
+		panic("Could not allocate startup tasks...");
+	}
+
+	for (int i = 0; i < n; i++) {
+		if (states[i].state == TaskWaiting && !hasdep(i)) {
+			launch(i);
+		}
+	}
+}
+
+void taskexited(pid_t pid, int status) {
+	for (int i = 0; i < ntasks; i++) {
+		if (states[i].state == TaskRunning && states[i].pid == pid) {
+			finish(i, WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+			return;
+		}
+	}
+}
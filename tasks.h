@@ -0,0 +1,20 @@
+#ifndef TASKS_H
+#define TASKS_H
+
+#include <sys/types.h>
+
+// a startup task runs either a shell command or a function, after the task
+// named in after has finished
+typedef struct Task Task;
+struct Task {
+	const char *name;
+	const char *cmd;
+	void (*func)();
+	const char *after;
+};
+
+void taskstart(const Task *t, int n);
+// called for every reaped child, finishes the task it belonged to if any
+void taskexited(pid_t pid, int status);
+
+#endif
@@ -0,0 +1,48 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stats.h"
+#include "trace.h"
+
+static FILE *tracefile = NULL;
+static uint64_t tracestart;
+
+int traceopen(const char *path, Window root, int width, int height) {
+	tracefile = fopen(path, "we");
+	if (tracefile == NULL) return -1;
+	// records go out in large writes, not one per event
+	setvbuf(tracefile, NULL, _IOFBF, 1 << 16);
+
+	TraceHeader h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, TRACE_MAGIC, sizeof(h.magic));
+	h.version = TRACE_VERSION;
+	h.evsize = sizeof(XEvent);
+	h.width = width;
+	h.height = height;
+	h.root = root;
+	fwrite(&h, sizeof(h), 1, tracefile);
+
+	tracestart = statbegin();
+	atexit(traceclose);
+	return 0;
+}
+
+void tracewrite(const XEvent *ev, uint32_t flags, uint64_t start, uint32_t requests) {
+	if (tracefile == NULL) return;
+
+	TraceRec r;
+	memset(&r, 0, sizeof(r));
+	r.ns = start - tracestart;
+	r.flags = flags;
+	r.requests = requests;
+	r.handlerns = statbegin() - start;
+	r.ev = *ev;
+	fwrite(&r, sizeof(r), 1, tracefile);
+}
+
+void traceclose() {
+	if (tracefile == NULL) return;
+	fclose(tracefile);
+	tracefile = NULL;
+}
@@ -0,0 +1,51 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <X11/Xlib.h>
+
+// IWM_TRACE=file records every event iwm dispatches, bench/replay plays a
+// trace back against a fresh server
+#define TRACE_MAGIC "IWMTRACE"
+#define TRACE_VERSION 1
+
+// what only iwm knew when it handled the event
+enum {
+	// about a window of iwm itself, a bar
+	TraceOwn = 1 << 0,
+	// an unmap iwm caused by hiding a client
+	TraceExpected = 1 << 1,
+};
+
+typedef struct TraceHeader TraceHeader;
+struct TraceHeader {
+	char magic[8];
+	uint32_t version;
+	// events are stored as they are, so a trace only replays on the ABI
+	// it was recorded on
+	uint32_t evsize;
+	uint32_t width;
+	uint32_t height;
+	// root window of the recorded session
+	uint64_t root;
+};
+
+typedef struct TraceRec TraceRec;
+struct TraceRec {
+	// dispatch time since the trace started
+	uint64_t ns;
+	uint32_t flags;
+	// requests the handler issued and how long it took
+	uint32_t requests;
+	uint32_t handlerns;
+	uint32_t pad;
+	XEvent ev;
+};
+
+// returns -1 when path can't be written
+int traceopen(const char *path, Window root, int width, int height);
+// start is the statbegin() timestamp taken before the handler ran
+void tracewrite(const XEvent *ev, uint32_t flags, uint64_t start, uint32_t requests);
+void traceclose();
+
+#endif
@@ -0,0 +1,100 @@
+#include <stdlib.h>
+#include "util.h"
+#include "wintab.h"
+
+// open addressing with linear probing, the table is kept at most half full
+// so probe sequences stay short and removal can shift entries back instead
+// of leaving tombstones around
+#define WT_MINSIZE 64
+
+static WinEntry *table = NULL;
+static size_t size = 0;
+static size_t count = 0;
+
+static size_t wthash(Window wnd) {
+	// xids of one client share the high bits, fibonacci hashing spreads them
+	return (size_t)(((unsigned long long)wnd * 0x9E3779B97F4A7C15ULL) >> 32) & (size - 1);
+}
+
+static void wtgrow() {
+	WinEntry *old = table;
+	size_t oldsize = size;
+
+	size = oldsize ? oldsize * 2 : WT_MINSIZE;
+	table = calloc(size, sizeof(WinEntry));
+	if (table == NULL) {
+		panic("Could not allocate window index...");
+	}
+
+	for (size_t i = 0; i < oldsize; i++) {
+		if (old[i].wnd == None) continue;
+		size_t j = wthash(old[i].wnd);
+		while (table[j].wnd != None) {
+			j = (j + 1) & (size - 1);
+		}
+		table[j] = old[i];
+	}
+	free(old);
+}
+
+void wtinsert(Window wnd, Client *c, Monitor *m) {
+	if (wnd == None) return;
+
+	if (2 * (count + 1) > size) {
+		wtgrow();
+	}
+
+	size_t i = wthash(wnd);
+	while (table[i].wnd != None && table[i].wnd != wnd) {
+		i = (i + 1) & (size - 1);
+	}
+	if (table[i].wnd == None) {
+		count++;
+	}
+
+	table[i].wnd = wnd;
+	table[i].client = c;
+	table[i].mon = m;
+}
+
+void wtremove(Window wnd) {
+	if (wnd == None || size == 0) return;
+
+	size_t i = wthash(wnd);
+	while (table[i].wnd != wnd) {
+		if (table[i].wnd == None) return;
+		i = (i + 1) & (size - 1);
+	}
+
+	// shift following entries of the cluster back into the hole
+	size_t j = i;
+	for (;;) {
+		table[i].wnd = None;
+		for (;;) {
+			j = (j + 1) & (size - 1);
+			if (table[j].wnd == None) {
+				count--;
+				return;
+			}
+			size_t k = wthash(table[j].wnd);
+			// entry at j may move to i only if its home slot k is not in (i, j]
+			if ((i <= j) ? (i < k && k <= j) : (i < k || k <= j)) continue;
+			break;
+		}
+		table[i] = table[j];
+		i = j;
+	}
+}
+
+WinEntry *wtlookup(Window wnd) {
+	if (wnd == None || size == 0) return NULL;
+
+	size_t i = wthash(wnd);
+	while (table[i].wnd != None) {
+		if (table[i].wnd == wnd) {
+			return &table[i];
+		}
+		i = (i + 1) & (size - 1);
+	}
+	return NULL;
+}
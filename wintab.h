@@ -0,0 +1,19 @@
+#ifndef WINTAB_H
+#define WINTAB_H
+
+#include "iwm.h"
+
+// window index, maps every window we know about to its client and monitor
+// bar windows have no client, client windows take their monitor from c->mon
+typedef struct WinEntry WinEntry;
+struct WinEntry {
+	Window wnd;
+	Client *client;
+	Monitor *mon;
+};
+
+void wtinsert(Window wnd, Client *c, Monitor *m);
+void wtremove(Window wnd);
+WinEntry *wtlookup(Window wnd);
+
+#endif